@@ -0,0 +1,214 @@
+#ifndef ACCUMULATOR
+#define ACCUMULATOR
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sum_of_table
+{
+
+// Shared running totals that many producers add to concurrently.
+enum class SharedMode
+{
+    Mutex,
+    Atomic,
+    Sharded,
+    Batched,
+};
+
+inline const char *sharedModeToString(SharedMode mode)
+{
+    switch (mode)
+    {
+    case SharedMode::Mutex:
+        return "mutex";
+    case SharedMode::Atomic:
+        return "atomic";
+    case SharedMode::Sharded:
+        return "sharded";
+    default:
+        return "batched";
+    }
+}
+
+constexpr size_t cacheLine = 64;
+
+// One lock per add: the baseline every other mode is measured against.
+template <typename T> class MutexAccumulator
+{
+  public:
+    void add(T value)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _total += value;
+    }
+
+    T load()
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _total;
+    }
+
+  private:
+    std::mutex _mtx;
+    T _total{};
+};
+
+// Compare-and-swap loop on a single cache line, no lock but every add still contends.
+template <typename T> class AtomicAccumulator
+{
+  public:
+    void add(T value)
+    {
+        T expected = _total.load(std::memory_order_relaxed);
+        while (!_total.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    T load() const
+    {
+        return _total.load(std::memory_order_relaxed);
+    }
+
+  private:
+    alignas(cacheLine) std::atomic<T> _total{};
+};
+
+// One padded slot per producer thread, merged on load. Each thread claims the next free shard
+// the first time it adds, so adds never contend as long as there are no more threads than
+// shards; past that the claims wrap around and share.
+template <typename T> class ShardedAccumulator
+{
+  public:
+    explicit ShardedAccumulator(size_t shardCount = std::thread::hardware_concurrency())
+        : _id{nextId()}, _shards(shardCount == 0 ? 1 : shardCount)
+    {
+    }
+
+    void add(T value)
+    {
+        std::atomic<T> &shard = _shards[shardIndex()].total;
+
+        T expected = shard.load(std::memory_order_relaxed);
+        while (!shard.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    T load() const
+    {
+        T total{};
+        for (const Shard &shard : _shards)
+        {
+            total += shard.total.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+  private:
+    struct alignas(cacheLine) Shard
+    {
+        std::atomic<T> total{};
+    };
+
+    // The claim is remembered for the accumulator the thread last added to, by id rather than
+    // address so a new accumulator in the old one's memory claims afresh.
+    size_t shardIndex()
+    {
+        struct Claim
+        {
+            uint64_t owner{0};
+            size_t shard{0};
+        };
+        static thread_local Claim claim;
+
+        if (claim.owner != _id)
+        {
+            claim = {_id, _claimed.fetch_add(1, std::memory_order_relaxed)};
+        }
+        return claim.shard % _shards.size();
+    }
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> ids{0};
+        return ids.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    uint64_t _id;
+    std::vector<Shard> _shards;
+    std::atomic<size_t> _claimed{0};
+};
+
+// Producers sum locally and take the lock once every flushEvery adds.
+template <typename T> class BatchedAccumulator
+{
+  public:
+    class Batch
+    {
+      public:
+        Batch(BatchedAccumulator &owner, size_t flushEvery) : _owner{owner}, _flushEvery{flushEvery}
+        {
+        }
+        ~Batch()
+        {
+            flush();
+        }
+
+        void add(T value)
+        {
+            _local += value;
+            if (++_count == _flushEvery)
+            {
+                flush();
+            }
+        }
+
+        void flush()
+        {
+            if (_count == 0)
+                return;
+
+            std::lock_guard<std::mutex> lock(_owner._mtx);
+            _owner._total += _local;
+            _local = T{};
+            _count = 0;
+        }
+
+      private:
+        BatchedAccumulator &_owner;
+        size_t _flushEvery;
+        T _local{};
+        size_t _count{0};
+    };
+
+    Batch batch(size_t flushEvery = 1024)
+    {
+        return Batch(*this, flushEvery);
+    }
+
+    void add(T value)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _total += value;
+    }
+
+    T load()
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _total;
+    }
+
+  private:
+    std::mutex _mtx;
+    T _total{};
+};
+
+} // namespace sum_of_table
+
+#endif
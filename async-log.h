@@ -0,0 +1,400 @@
+#ifndef ASYNC_LOG
+#define ASYNC_LOG
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace async_log
+{
+
+enum class Severity : uint8_t
+{
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+// Who is logging. index picks the category's bit in the runtime filter (0 to 63).
+struct Category
+{
+    unsigned index;
+    const char *name;
+    const char *color;
+    bool showId;
+};
+
+// One deferred argument: the raw value plus the function that prints it on the writer thread.
+// Strings are kept as pointers, so only pass literals or other static strings.
+struct Arg
+{
+    void (*print)(std::ostream &os, const Arg &arg);
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const char *s;
+        unsigned char bytes[16];
+    };
+};
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>, int> = 0> Arg logArg(T value)
+{
+    Arg arg{[](std::ostream &os, const Arg &a) { os << a.i; }, {}};
+    arg.i = value;
+    return arg;
+}
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>, int> = 0> Arg logArg(T value)
+{
+    Arg arg{[](std::ostream &os, const Arg &a) { os << a.u; }, {}};
+    arg.u = value;
+    return arg;
+}
+
+inline Arg logArg(double value)
+{
+    Arg arg{[](std::ostream &os, const Arg &a) { os << a.d; }, {}};
+    arg.d = value;
+    return arg;
+}
+
+inline Arg logArg(const char *value)
+{
+    Arg arg{[](std::ostream &os, const Arg &a) { os << a.s; }, {}};
+    arg.s = value;
+    return arg;
+}
+
+constexpr size_t maxArgs = 6;
+
+// Fixed-size, trivially copyable: the producer only stores pointers and raw values, every
+// bit of formatting happens on the writer thread.
+struct Record
+{
+    int64_t time;
+    const Category *category;
+    const char *format;
+    unsigned id;
+    Severity severity;
+    uint8_t argCount;
+    Arg args[maxArgs];
+};
+
+// Process-wide asynchronous logger. Each logging thread fills its own single-producer ring,
+// a background writer drains them all, orders the batch by time, formats it with "{}"
+// placeholders and writes it in one go. Disabled severities or categories return after two
+// relaxed loads.
+class Logger
+{
+  public:
+    static Logger &getInstance();
+
+    template <typename... Args>
+    void log(Severity severity, const Category &category, unsigned id, const char *format, const Args &...args);
+
+    bool enabled(Severity severity, const Category &category) const
+    {
+        return severity >= _minSeverity.load(std::memory_order_relaxed) &&
+               (_categories.load(std::memory_order_relaxed) >> category.index & 1);
+    }
+
+    void setMinSeverity(Severity severity)
+    {
+        _minSeverity.store(severity, std::memory_order_relaxed);
+    }
+
+    void enableCategory(const Category &category, bool enable)
+    {
+        uint64_t bit = uint64_t{1} << category.index;
+        if (enable)
+            _categories.fetch_or(bit, std::memory_order_relaxed);
+        else
+            _categories.fetch_and(~bit, std::memory_order_relaxed);
+    }
+
+    // Returns once everything logged before the call (by threads that happen-before it) is written.
+    void flush();
+
+  private:
+    static constexpr size_t bufferCapacity = 256;
+    static constexpr auto batchDelay = std::chrono::milliseconds(1);
+
+    struct Buffer
+    {
+        Record records[bufferCapacity];
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<bool> retired{false};
+    };
+
+    // Retires the thread's buffer when the thread exits, the writer frees it once drained.
+    struct LocalBuffer
+    {
+        std::shared_ptr<Buffer> buffer{};
+        ~LocalBuffer()
+        {
+            if (buffer)
+                buffer->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    Logger();
+    ~Logger();
+
+    Buffer &localBuffer();
+    void publish(Buffer &buffer, size_t tail);
+    void wakeWriter(bool hurry = false);
+
+    void writerLoop();
+    void drain(std::vector<Record> &batch);
+    void write(const std::vector<Record> &batch);
+    const std::string &timePrefix(int64_t time);
+
+    std::atomic<Severity> _minSeverity{Severity::Info};
+    std::atomic<uint64_t> _categories{~uint64_t{0}};
+
+    std::mutex _buffersMtx;
+    std::vector<std::shared_ptr<Buffer>> _buffers{};
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::condition_variable _flushedCv;
+    std::atomic<bool> _dirty{false};
+    size_t _flushRequested{0};
+    size_t _flushed{0};
+    bool _hurry{false};
+    bool _stop{false};
+
+    int64_t _cachedSecond{-1};
+    std::string _cachedPrefix{};
+    std::ostringstream _out{};
+
+    std::thread _writer;
+};
+
+inline Logger &Logger::getInstance()
+{
+    static Logger instance;
+    return instance;
+}
+
+inline Logger::Logger() : _writer{[this]() { writerLoop(); }}
+{
+}
+
+inline Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _writer.join();
+}
+
+inline Logger::Buffer &Logger::localBuffer()
+{
+    static thread_local LocalBuffer local;
+
+    if (!local.buffer)
+    {
+        local.buffer = std::make_shared<Buffer>();
+
+        std::lock_guard<std::mutex> lock(_buffersMtx);
+        _buffers.push_back(local.buffer);
+    }
+    return *local.buffer;
+}
+
+template <typename... Args>
+void Logger::log(Severity severity, const Category &category, unsigned id, const char *format, const Args &...args)
+{
+    static_assert(sizeof...(Args) <= maxArgs, "too many log arguments");
+
+    if (!enabled(severity, category))
+        return;
+
+    Buffer &buffer = localBuffer();
+    size_t tail = buffer.tail.load(std::memory_order_relaxed);
+
+    // a full buffer means the writer is behind: hurry it up rather than drop the line
+    while (tail - buffer.head.load(std::memory_order_acquire) == bufferCapacity)
+    {
+        wakeWriter(true);
+        std::this_thread::yield();
+    }
+
+    Record &record = buffer.records[tail % bufferCapacity];
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    record.category = &category;
+    record.format = format;
+    record.id = id;
+    record.severity = severity;
+    record.argCount = sizeof...(Args);
+
+    [[maybe_unused]] size_t i = 0;
+    ((record.args[i++] = logArg(args)), ...);
+
+    publish(buffer, tail + 1);
+}
+
+// The writer clears _dirty before it reads the tails, producers read _dirty after they move a
+// tail: both seq_cst, so either the writer sees the record or the producer wakes it. Only the
+// first record of a batch pays for the wakeup.
+inline void Logger::publish(Buffer &buffer, size_t tail)
+{
+    buffer.tail.store(tail);
+
+    if (!_dirty.load() && !_dirty.exchange(true))
+    {
+        wakeWriter();
+    }
+}
+
+inline void Logger::wakeWriter(bool hurry)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _hurry = _hurry || hurry;
+    }
+    _cv.notify_one();
+}
+
+inline void Logger::flush()
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    size_t ticket = ++_flushRequested;
+    _cv.notify_one();
+    _flushedCv.wait(lock, [&] { return _flushed >= ticket; });
+}
+
+inline void Logger::writerLoop()
+{
+    std::vector<Record> batch;
+
+    for (;;)
+    {
+        size_t ticket;
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [&] { return _stop || _dirty.load() || _flushRequested > _flushed; });
+
+            // let a burst pile up so it goes out as one write, unless someone is waiting on it
+            _cv.wait_for(lock, batchDelay, [&] { return _stop || _hurry || _flushRequested > _flushed; });
+
+            ticket = _flushRequested;
+            stop = _stop;
+            _hurry = false;
+        }
+
+        _dirty.store(false);
+        drain(batch);
+        write(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _flushed = ticket;
+        }
+        _flushedCv.notify_all();
+
+        if (stop)
+            return;
+    }
+}
+
+inline void Logger::drain(std::vector<Record> &batch)
+{
+    batch.clear();
+
+    std::lock_guard<std::mutex> lock(_buffersMtx);
+    for (auto it = _buffers.begin(); it != _buffers.end();)
+    {
+        Buffer &buffer = **it;
+        bool retired = buffer.retired.load(std::memory_order_acquire);
+
+        size_t head = buffer.head.load(std::memory_order_relaxed);
+        size_t tail = buffer.tail.load();
+        for (; head != tail; head++)
+        {
+            batch.push_back(buffer.records[head % bufferCapacity]);
+        }
+        buffer.head.store(head, std::memory_order_release);
+
+        it = retired ? _buffers.erase(it) : it + 1;
+    }
+
+    // each buffer is already in order, the stable sort only interleaves threads
+    std::stable_sort(batch.begin(), batch.end(), [](const Record &a, const Record &b) { return a.time < b.time; });
+}
+
+inline const std::string &Logger::timePrefix(int64_t time)
+{
+    int64_t second = time / 1000000000;
+    if (second != _cachedSecond)
+    {
+        std::time_t t = static_cast<std::time_t>(second);
+        std::tm tm = *std::localtime(&t);
+
+        std::ostringstream oss;
+        oss << std::put_time(&tm, "[%H:%M:%S]");
+        _cachedPrefix = oss.str();
+        _cachedSecond = second;
+    }
+    return _cachedPrefix;
+}
+
+inline void Logger::write(const std::vector<Record> &batch)
+{
+    if (batch.empty())
+        return;
+
+    _out.str("");
+    for (const Record &record : batch)
+    {
+        const Category &category = *record.category;
+
+        _out << timePrefix(record.time) << category.color << " " << category.name;
+        if (category.showId)
+            _out << " " << record.id;
+        _out << " : \033[0m";
+
+        const char *text = record.format;
+        for (size_t arg = 0; arg < record.argCount; arg++)
+        {
+            const char *placeholder = std::strstr(text, "{}");
+            if (!placeholder)
+                break;
+
+            _out.write(text, placeholder - text);
+            record.args[arg].print(_out, record.args[arg]);
+            text = placeholder + 2;
+        }
+        _out << text << '\n';
+    }
+
+    std::string text = _out.str();
+    std::cout.write(text.data(), text.size());
+    std::cout.flush();
+}
+
+} // namespace async_log
+
+#endif
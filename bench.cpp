@@ -0,0 +1,1267 @@
+#include "accumulator.h"
+#include "async-log.h"
+#include "count.h"
+#include "load.h"
+#include "matrix.h"
+#include "multi-queue.h"
+#include "restaurant.h"
+#include "ring-buffer.h"
+#include "simd-sum.h"
+#include "strassen.h"
+#include "sum-of-table.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+struct Options
+{
+    std::string format{"table"};
+    std::string filter{};
+    size_t warmup{1};
+    size_t repeats{7};
+    size_t maxThreads{std::max(4u, std::thread::hardware_concurrency())};
+    bool quick{false};
+};
+
+struct Result
+{
+    std::string suite;
+    std::string kernel;
+    size_t size;
+    size_t threads;
+    double median;
+    double p99;
+    double mean;
+    double throughput;
+    std::string unit;
+    double speedup;
+};
+
+// Swallows std::cout while kernels that print (count, restaurant) are being timed.
+class SilenceStdout
+{
+  public:
+    SilenceStdout() : _previous{std::cout.rdbuf(&_null)}
+    {
+    }
+    ~SilenceStdout()
+    {
+        std::cout.rdbuf(_previous);
+    }
+
+  private:
+    struct NullBuffer : std::streambuf
+    {
+        int overflow(int c) override
+        {
+            return c;
+        }
+    };
+
+    NullBuffer _null;
+    std::streambuf *_previous;
+};
+
+// Nearest-rank percentile of already sorted samples.
+inline double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+class Harness
+{
+  public:
+    Harness(const Options &options) : _options{options}
+    {
+    }
+
+    bool enabled(const std::string &suite) const
+    {
+        return _options.filter.empty() || suite.find(_options.filter) != std::string::npos;
+    }
+
+    // For a bench recording several suites: whether the filter picks any of them.
+    bool enabled(std::initializer_list<std::string> suites) const
+    {
+        return std::any_of(suites.begin(), suites.end(), [&](const std::string &suite) { return enabled(suite); });
+    }
+
+    // Times f() after warmup runs. items is the work done by one call, reported per second.
+    // The first kernel marked as baseline for a (suite, size) pair is what speedups refer to.
+    template <typename F>
+    void run(const std::string &suite, const std::string &kernel, size_t size, size_t threads, double items,
+             const std::string &unit, bool baseline, F &&f, size_t repeats = 0)
+    {
+        repeats = repeats == 0 ? _options.repeats : std::min(repeats, _options.repeats);
+
+        for (size_t i = 0; i < _options.warmup; i++)
+        {
+            f();
+        }
+
+        std::vector<double> samples;
+        for (size_t i = 0; i < repeats; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double>(end - start).count());
+        }
+
+        record(suite, kernel, size, threads, items, unit, baseline, std::move(samples));
+    }
+
+    // Same as run() for samples measured some other way, in seconds.
+    void record(const std::string &suite, const std::string &kernel, size_t size, size_t threads, double items,
+                const std::string &unit, bool baseline, std::vector<double> samples)
+    {
+        // a bench recording several suites runs whole, only what the filter picks is kept
+        if (!enabled(suite))
+            return;
+
+        std::sort(samples.begin(), samples.end());
+
+        double mean = 0.0;
+        for (double sample : samples)
+        {
+            mean += sample / samples.size();
+        }
+        double median = percentile(samples, 0.5);
+
+        auto key = std::make_pair(suite, size);
+        if (baseline && _baselines.find(key) == _baselines.end())
+        {
+            _baselines[key] = median;
+        }
+        auto it = _baselines.find(key);
+        double speedup = it == _baselines.end() ? 0.0 : it->second / median;
+
+        _results.push_back(
+            {suite, kernel, size, threads, median, percentile(samples, 0.99), mean, items / median, unit, speedup});
+    }
+
+    void report(std::ostream &os) const
+    {
+        if (_options.format == "csv")
+        {
+            os << "suite,kernel,size,threads,median_s,p99_s,mean_s,throughput,unit,speedup" << std::endl;
+            for (const Result &r : _results)
+            {
+                os << r.suite << "," << r.kernel << "," << r.size << "," << r.threads << "," << r.median << ","
+                   << r.p99 << "," << r.mean << "," << r.throughput << "," << r.unit << "," << r.speedup << std::endl;
+            }
+        }
+        else if (_options.format == "json")
+        {
+            os << "{" << std::endl;
+            os << "  \"isa\": \"" << simd::isaToString(simd::detectIsa()) << "\"," << std::endl;
+            os << "  \"pool_threads\": " << thread_pool::ThreadPool::getInstance().size() << "," << std::endl;
+            os << "  \"results\": [" << std::endl;
+            for (size_t i = 0; i < _results.size(); i++)
+            {
+                const Result &r = _results[i];
+                os << "    {\"suite\": \"" << r.suite << "\", \"kernel\": \"" << r.kernel << "\", \"size\": " << r.size
+                   << ", \"threads\": " << r.threads << ", \"median_s\": " << r.median << ", \"p99_s\": " << r.p99
+                   << ", \"mean_s\": " << r.mean << ", \"throughput\": " << r.throughput << ", \"unit\": \""
+                   << r.unit << "\", \"speedup\": " << r.speedup << "}" << (i + 1 < _results.size() ? "," : "")
+                   << std::endl;
+            }
+            os << "  ]" << std::endl << "}" << std::endl;
+        }
+        else
+        {
+            os << std::left << std::setw(12) << "suite" << std::setw(24) << "kernel" << std::right << std::setw(10)
+               << "size" << std::setw(4) << "thr" << std::setw(14) << "median" << std::setw(14) << "p99"
+               << std::setw(12) << "throughput" << std::setw(19) << "speedup" << std::endl;
+            for (const Result &r : _results)
+            {
+                printRow(os, r);
+            }
+        }
+    }
+
+    const Options &options() const
+    {
+        return _options;
+    }
+
+  private:
+    static void printRow(std::ostream &os, const Result &r)
+    {
+        os << std::left << std::setw(12) << r.suite << std::setw(24) << r.kernel << std::right << std::setw(10)
+           << r.size << std::setw(4) << r.threads << std::fixed << std::setprecision(3) << std::setw(12)
+           << r.median * 1e3 << "ms" << std::setw(12) << r.p99 * 1e3 << "ms" << std::scientific
+           << std::setprecision(2) << std::setw(12) << r.throughput << " " << std::left << std::setw(9) << r.unit
+           << std::right << std::fixed << std::setw(8) << r.speedup << "x" << std::endl;
+    }
+
+    Options _options;
+    std::vector<Result> _results{};
+    std::map<std::pair<std::string, size_t>, double> _baselines{};
+};
+
+std::vector<size_t> threadSweep(const Options &options)
+{
+    std::vector<size_t> threads;
+    for (size_t t = 1; t <= options.maxThreads; t *= 2)
+    {
+        threads.push_back(t);
+    }
+    return threads;
+}
+
+// Strassen trades accuracy for flops, make sure the trade stays within the usual bound.
+void checkError(const matrix::Matrix &expected, const matrix::Matrix &actual, int n)
+{
+    double error = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            error = std::max(error, std::abs(expected(i, j) - actual(i, j)));
+        }
+    }
+    if (error > 1e-12 * n)
+    {
+        throw("strassen error out of bounds");
+    }
+}
+
+// The range overloads next to <numeric>: an unqualified forward would be ambiguous with std::reduce.
+void checkReduce()
+{
+    std::vector<int64_t> values(1000);
+    std::iota(values.begin(), values.end(), int64_t{1});
+
+    if (sum_of_table::reduce(values, int64_t{0}, std::plus<>{}) != 500500 ||
+        sum_of_table::reduce(values, int64_t{0}, sum_of_table::Plus<int64_t>{}) != 500500 ||
+        sum_of_table::transformReduce(values, int64_t{0}, sum_of_table::Plus<int64_t>{},
+                                      [](int64_t x) { return 2 * x; }) != 1001000 ||
+        sum_of_table::countIf(values, [](int64_t x) { return x % 2 == 0; }) != 500)
+    {
+        throw("reduce returned a wrong result");
+    }
+}
+
+// parallelDeterministic promises the same bits whatever the thread count.
+void checkDeterministic(const std::vector<float> &table)
+{
+    float expected = sum_of_table::parallelDeterministic(table, 1);
+
+    size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads : {size_t{2}, size_t{4}, hardware})
+    {
+        float actual = sum_of_table::parallelDeterministic(table, threads);
+        if (std::memcmp(&expected, &actual, sizeof(float)) != 0)
+        {
+            throw("parallelDeterministic depends on the thread count");
+        }
+    }
+}
+
+void benchMatrix(Harness &harness)
+{
+    std::vector<int> sizes = harness.options().quick ? std::vector<int>{64, 128} : std::vector<int>{64, 128, 256, 512};
+    size_t poolThreads = thread_pool::ThreadPool::getInstance().size();
+
+    std::mt19937 g(42);
+    std::uniform_real_distribution<double> d(-1.0, 1.0);
+
+    for (int n : sizes)
+    {
+        matrix::Matrix a{n, n}, b{n, n};
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = 0; j < n; j++)
+            {
+                a(i, j) = d(g);
+                b(i, j) = d(g);
+            }
+        }
+
+        double flops = 2.0 * n * n * n;
+        harness.run("matrix", "sequencial", n, 1, flops, "flop/s", true, [&] { matrix::sequencial(a, b); });
+        harness.run("matrix", "parallel", n, poolThreads, flops, "flop/s", false, [&] { matrix::parallel(a, b); });
+
+        // small leaf and cutoff so the recursion and Strassen levels show up at bench sizes
+        matrix::RecursiveOptions quadrants{32, static_cast<size_t>(n)};
+        matrix::RecursiveOptions strassen{32, 32};
+        checkError(matrix::parallel(a, b), matrix::recursive(a, b, strassen), n);
+
+        harness.run("matrix", "recursive", n, poolThreads, flops, "flop/s", false,
+                    [&] { matrix::recursive(a, b, quadrants); });
+        harness.run("matrix", "strassen", n, poolThreads, flops, "flop/s", false,
+                    [&] { matrix::recursive(a, b, strassen); });
+    }
+}
+
+void benchSum(Harness &harness)
+{
+    std::vector<size_t> sizes = harness.options().quick ? std::vector<size_t>{10000, 1000000}
+                                                        : std::vector<size_t>{10000, 1000000, 10000000};
+
+    checkReduce();
+
+    std::mt19937 g(42);
+    std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+
+    for (size_t n : sizes)
+    {
+        std::vector<float> table(n);
+        for (float &x : table)
+        {
+            x = d(g);
+        }
+
+        checkDeterministic(table);
+
+        volatile float sink = 0.0f;
+        double items = static_cast<double>(n);
+
+        harness.run("sum", "sequencial", n, 1, items, "elem/s", true, [&] { sink = sum_of_table::sequencial(table); });
+        harness.run("sum", "simd", n, 1, items, "elem/s", false, [&] { sink = sum_of_table::simd(table); });
+        harness.run("sum", "reduce", n, thread_pool::ThreadPool::getInstance().size(), items, "elem/s", false,
+                    [&] { sink = sum_of_table::reduce(table, 0.0f, sum_of_table::Plus<float>{}); });
+
+        for (size_t threads : threadSweep(harness.options()))
+        {
+            harness.run("sum", "parallel", n, threads, items, "elem/s", false,
+                        [&] { sink = sum_of_table::parallel(table, threads); });
+            harness.run("sum", "parallelSimd", n, threads, items, "elem/s", false,
+                        [&] { sink = sum_of_table::parallelSimd(table, threads); });
+            harness.run("sum", "parallelDeterministic", n, threads, items, "elem/s", false,
+                        [&] { sink = sum_of_table::parallelDeterministic(table, threads); });
+            harness.run("sum", "parallelMutex", n, threads, items, "elem/s", false,
+                        [&] { sink = sum_of_table::parallelMutex(table, threads); }, 3);
+        }
+    }
+}
+
+// Producers on dedicated threads, so the number of concurrent writers is exactly threadCount.
+template <typename Accumulator, typename Producer>
+void produce(Accumulator &accumulator, size_t threadCount, size_t addsPerThread, Producer producer)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.push_back(std::thread([&]() { producer(accumulator, addsPerThread); }));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (accumulator.load() != static_cast<double>(threadCount * addsPerThread))
+    {
+        throw("accumulator lost updates");
+    }
+}
+
+void benchAccumulator(Harness &harness)
+{
+    using namespace sum_of_table;
+
+    size_t addsPerThread = harness.options().quick ? (1 << 16) : (1 << 20);
+
+    auto addOne = [](auto &accumulator, size_t adds) {
+        for (size_t i = 0; i < adds; i++)
+        {
+            accumulator.add(1.0);
+        }
+    };
+    auto addBatched = [](auto &accumulator, size_t adds) {
+        auto batch = accumulator.batch();
+        for (size_t i = 0; i < adds; i++)
+        {
+            batch.add(1.0);
+        }
+    };
+
+    for (size_t threads : threadSweep(harness.options()))
+    {
+        double items = static_cast<double>(threads * addsPerThread);
+
+        harness.run("accumulator", "mutex", addsPerThread, threads, items, "add/s", threads == 1, [&] {
+            MutexAccumulator<double> accumulator;
+            produce(accumulator, threads, addsPerThread, addOne);
+        });
+        harness.run("accumulator", "atomic", addsPerThread, threads, items, "add/s", false, [&] {
+            AtomicAccumulator<double> accumulator;
+            produce(accumulator, threads, addsPerThread, addOne);
+        });
+        harness.run("accumulator", "sharded", addsPerThread, threads, items, "add/s", false, [&] {
+            ShardedAccumulator<double> accumulator(threads);
+            produce(accumulator, threads, addsPerThread, addOne);
+        });
+        harness.run("accumulator", "batched", addsPerThread, threads, items, "add/s", false, [&] {
+            BatchedAccumulator<double> accumulator;
+            produce(accumulator, threads, addsPerThread, addBatched);
+        });
+    }
+}
+
+// What the kitchen queue used to be: std::queue behind a mutex and condition variable.
+template <typename T> class MutexQueue
+{
+  public:
+    bool push(T value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _queue.push(std::move(value));
+        }
+        _cv.notify_one();
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [&] { return _closed || !_queue.empty(); });
+        if (_queue.empty())
+            return false;
+
+        value = std::move(_queue.front());
+        _queue.pop();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _closed = true;
+        }
+        _cv.notify_all();
+    }
+
+  private:
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::queue<T> _queue{};
+    bool _closed{false};
+};
+
+// Consumers that wait with a timeout, like a worker with housekeeping to do between items.
+template <typename T> class TimedPop
+{
+  public:
+    explicit TimedPop(size_t capacity) : _queue{capacity}
+    {
+    }
+
+    bool push(T value)
+    {
+        return _queue.push(std::move(value));
+    }
+
+    bool pop(T &value)
+    {
+        while (!_queue.popFor(value, std::chrono::milliseconds(1)))
+        {
+            if (_queue.isClosed())
+                return _queue.tryPop(value);
+        }
+        return true;
+    }
+
+    void close()
+    {
+        _queue.close();
+    }
+
+  private:
+    ring_buffer::RingBuffer<T> _queue;
+};
+
+// threadCount producers hand itemsPerThread items each to threadCount consumers.
+template <typename Queue> void handOff(Queue &queue, size_t threadCount, size_t itemsPerThread)
+{
+    std::atomic<size_t> received{0};
+
+    std::vector<std::thread> consumers;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        consumers.push_back(std::thread([&]() {
+            size_t value;
+            while (queue.pop(value))
+            {
+                received.fetch_add(1, std::memory_order_relaxed);
+            }
+        }));
+    }
+
+    std::vector<std::thread> producers;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        producers.push_back(std::thread([&]() {
+            for (size_t j = 0; j < itemsPerThread; j++)
+            {
+                queue.push(j);
+            }
+        }));
+    }
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+
+    queue.close();
+    for (auto &consumer : consumers)
+    {
+        consumer.join();
+    }
+
+    if (received.load() != threadCount * itemsPerThread)
+    {
+        throw("queue lost items");
+    }
+}
+
+void benchQueue(Harness &harness)
+{
+    size_t itemsPerThread = harness.options().quick ? (1 << 14) : (1 << 18);
+
+    for (size_t threads : threadSweep(harness.options()))
+    {
+        double items = static_cast<double>(threads * itemsPerThread);
+
+        harness.run("queue", "mutex", itemsPerThread, threads, items, "item/s", threads == 1, [&] {
+            MutexQueue<size_t> queue;
+            handOff(queue, threads, itemsPerThread);
+        });
+        // roomy enough to never fill, then the restaurant's size where backpressure kicks in
+        harness.run("queue", "ringBuffer", itemsPerThread, threads, items, "item/s", false, [&] {
+            ring_buffer::RingBuffer<size_t> queue(itemsPerThread);
+            handOff(queue, threads, itemsPerThread);
+        });
+        harness.run("queue", "ringBufferBounded", itemsPerThread, threads, items, "item/s", false, [&] {
+            ring_buffer::RingBuffer<size_t> queue(restaurant::queueCapacity);
+            handOff(queue, threads, itemsPerThread);
+        });
+        harness.run("queue", "ringBufferTimed", itemsPerThread, threads, items, "item/s", false, [&] {
+            TimedPop<size_t> queue(restaurant::queueCapacity);
+            handOff(queue, threads, itemsPerThread);
+        });
+    }
+}
+
+// Every thread pushes a random key on its shard and pops the smallest top it can see, like a
+// cook under a priority policy. With one shard that is a single heap behind a global lock.
+void churn(multi_queue::MultiQueue<size_t> &queue, size_t threadCount, size_t itemsPerThread)
+{
+    std::atomic<size_t> popped{0};
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.push_back(std::thread([&, i]() {
+            std::mt19937_64 random(i + 1);
+            size_t own = i % queue.shardCount();
+            size_t value;
+            for (size_t j = 0; j < itemsPerThread; j++)
+            {
+                queue.push(own, random() >> 1, j);
+
+                size_t best = own;
+                for (size_t k = 0; k < queue.shardCount(); k++)
+                {
+                    best = queue.top(k) < queue.top(best) ? k : best;
+                }
+                if (queue.tryPop(best, value) || queue.tryPop(own, value))
+                {
+                    popped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (size_t k = 0; k < queue.shardCount(); k++)
+    {
+        size_t value;
+        while (queue.tryPop(k, value))
+        {
+            popped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (popped.load() != threadCount * itemsPerThread)
+    {
+        throw("priority queue lost items");
+    }
+}
+
+void benchPriorityQueue(Harness &harness)
+{
+    size_t itemsPerThread = harness.options().quick ? (1 << 14) : (1 << 17);
+
+    for (size_t threads : threadSweep(harness.options()))
+    {
+        double items = static_cast<double>(threads * itemsPerThread);
+
+        harness.run("pqueue", "globalHeap", itemsPerThread, threads, items, "item/s", true, [&] {
+            multi_queue::MultiQueue<size_t> queue(1, itemsPerThread);
+            churn(queue, threads, itemsPerThread);
+        });
+        harness.run("pqueue", "multiQueue", itemsPerThread, threads, items, "item/s", false, [&] {
+            multi_queue::MultiQueue<size_t> queue(threads, itemsPerThread);
+            churn(queue, threads, itemsPerThread);
+        });
+    }
+}
+
+// What restaurant logging used to be: format on the caller, then one global lock, localtime
+// and a flush per line.
+void logLocked(const std::string &line)
+{
+    static std::mutex mtx;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto t = std::time(nullptr);
+    auto tm = *std::localtime(&t);
+    std::cout << std::put_time(&tm, "[%H:%M:%S]") << line << std::endl;
+}
+
+template <typename F> void logFrom(size_t threadCount, size_t linesPerThread, F logLine)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.push_back(std::thread([&, i]() {
+            for (size_t j = 0; j < linesPerThread; j++)
+            {
+                logLine(static_cast<unsigned int>(i), j);
+            }
+        }));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void benchLog(Harness &harness)
+{
+    constexpr async_log::Category benchLog{63, "Bench", "\033[36m", true};
+
+    size_t linesPerThread = harness.options().quick ? (1 << 12) : (1 << 15);
+    async_log::Logger &logger = async_log::Logger::getInstance();
+
+    SilenceStdout silence;
+
+    for (size_t threads : threadSweep(harness.options()))
+    {
+        double items = static_cast<double>(threads * linesPerThread);
+
+        harness.run("log", "mutex", linesPerThread, threads, items, "line/s", true, [&] {
+            logFrom(threads, linesPerThread, [](unsigned int id, size_t j) {
+                std::ostringstream oss;
+                oss << "line " << j << " of " << 3.5;
+                logLocked("\033[36m Bench " + std::to_string(id) + " : \033[0m" + oss.str());
+            });
+        });
+        harness.run("log", "async", linesPerThread, threads, items, "line/s", false, [&] {
+            logFrom(threads, linesPerThread, [&](unsigned int id, size_t j) {
+                logger.log(async_log::Severity::Info, benchLog, id, "line {} of {}", j, 3.5);
+            });
+            logger.flush();
+        });
+
+        logger.enableCategory(benchLog, false);
+        harness.run("log", "asyncFiltered", linesPerThread, threads, items, "line/s", false, [&] {
+            logFrom(threads, linesPerThread, [&](unsigned int id, size_t j) {
+                logger.log(async_log::Severity::Info, benchLog, id, "line {} of {}", j, 3.5);
+            });
+        });
+        logger.enableCategory(benchLog, true);
+    }
+}
+
+void benchCount(Harness &harness)
+{
+    SilenceStdout silence;
+
+    harness.run("count", "parallel", 1000, 2, 1000.0, "turn/s", true, [] { count::parallel(); });
+}
+
+// The turn-taking count::parallel used to do: one mutex, one condition variable, whose turn
+// it is behind the lock.
+class MutexTurns
+{
+  public:
+    explicit MutexTurns(size_t participants) : _participants{participants}
+    {
+    }
+
+    void wait(size_t participant)
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [&] { return _turn == participant; });
+    }
+
+    void pass(size_t participant)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _turn = (participant + 1) % _participants;
+        }
+        _cv.notify_all();
+    }
+
+  private:
+    size_t _participants;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    size_t _turn{0};
+};
+
+// Each participant takes rounds turns, doing nothing in them; returns the seconds it took.
+template <typename Turns> double pingPong(Turns &turns, size_t participants, size_t rounds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < participants; i++)
+    {
+        threads.emplace_back([&turns, i, rounds] {
+            for (size_t round = 0; round < rounds; round++)
+            {
+                turns.wait(i);
+                turns.pass(i);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Handoffs per second around rings of 2 to 8 threads, and the time for the turn to go once
+// around the ring (a round trip), for the old mutex and the two count:: primitives.
+void benchHandoff(Harness &harness)
+{
+    size_t rounds = harness.options().quick ? 2000 : 20000;
+    std::vector<size_t> rings = harness.options().quick ? std::vector<size_t>{2} : std::vector<size_t>{2, 4, 8};
+    size_t repeats = std::max<size_t>(harness.options().repeats, 1);
+
+    for (size_t participants : rings)
+    {
+        auto measure = [&](const std::string &kernel, bool baseline, auto make) {
+            std::vector<double> samples;
+            for (size_t r = 0; r < repeats; r++)
+            {
+                auto turns = make();
+                samples.push_back(pingPong(*turns, participants, rounds));
+            }
+
+            std::vector<double> trips;
+            for (double sample : samples)
+            {
+                trips.push_back(sample / rounds);
+            }
+
+            harness.record("handoff", kernel, participants, participants, double(participants * rounds), "handoff/s",
+                           baseline, std::move(samples));
+            harness.record("handoff-rtt", kernel, participants, participants, 1.0, "trip/s", baseline,
+                           std::move(trips));
+        };
+
+        measure("mutex", true, [&] { return std::make_unique<MutexTurns>(participants); });
+        measure("counter", false, [&] { return std::make_unique<count::TurnCounter>(participants); });
+        measure("flags", false, [&] { return std::make_unique<count::TurnFlags>(participants); });
+    }
+}
+
+// Ordered operations per second as the sequencer's ring grows: every count is a handoff, so
+// more threads only add contention, and the 1-thread run is the baseline.
+void benchSequencer(Harness &harness)
+{
+    int end = harness.options().quick ? 10000 : 100000;
+    std::vector<size_t> rings = harness.options().quick ? std::vector<size_t>{1, 2} : std::vector<size_t>{1, 2, 4, 8};
+
+    for (size_t threads : rings)
+    {
+        count::Sequencer sequencer(threads);
+        harness.run("sequencer", "flags", end, threads, double(end), "op/s", threads == 1,
+                    [&] { sequencer.run(end); });
+    }
+}
+
+void benchRestaurant(Harness &harness)
+{
+    std::vector<unsigned int> customers =
+        harness.options().quick ? std::vector<unsigned int>{5} : std::vector<unsigned int>{5, 10, 20};
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+
+    for (unsigned int n : customers)
+    {
+        SilenceStdout silence;
+
+        harness.run("restaurant", "simulation", n, 0, static_cast<double>(n), "meal/s", true, [&] {
+            restaurant->initialize(n);
+            restaurant->close();
+        }, 3);
+    }
+
+    // Same service on a virtual clock: only the bookkeeping between events costs wall time.
+    std::vector<unsigned int> virtualCustomers = harness.options().quick ? std::vector<unsigned int>{5, 1000}
+                                                                         : std::vector<unsigned int>{5, 10, 20, 10000};
+
+    restaurant->virtualTime = true;
+    for (unsigned int n : virtualCustomers)
+    {
+        SilenceStdout silence;
+
+        harness.run("restaurant", "virtual", n, 0, static_cast<double>(n), "meal/s", false, [&] {
+            restaurant->initialize(n);
+            restaurant->close();
+        }, 3);
+    }
+    restaurant->virtualTime = false;
+}
+
+// Serves n customers on the virtual clock repeats times, recording the simulated service time
+// and the customers' mean wait.
+void simulateService(unsigned int n, unsigned int waiters, size_t repeats, std::vector<double> &service,
+                     std::vector<double> &wait)
+{
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+    restaurant->virtualTime = true;
+
+    for (size_t i = 0; i < repeats; i++)
+    {
+        restaurant->initialize(n, waiters);
+        restaurant->close();
+        service.push_back(std::chrono::duration<double>(restaurant->serviceTime()).count());
+        wait.push_back(std::chrono::duration<double>(restaurant->meanWait()).count());
+    }
+
+    restaurant->virtualTime = false;
+}
+
+// What the instrumentation costs: one Histogram::record(), and per meal the eight marks it goes
+// through (a clock read and a record each, two more records on delivery), against the wall time
+// a meal takes in the virtual restaurant with metrics on. The restaurant is the baseline, so the
+// speedup of marks-per-meal is the inverse of the overhead: above 100x it is under 1%.
+void benchMetrics(Harness &harness)
+{
+#if METRICS_ENABLED
+    unsigned int n = harness.options().quick ? 1000 : 10000;
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+
+    {
+        SilenceStdout silence;
+
+        restaurant->virtualTime = true;
+        // flushed, so the log lines are written inside the run and not over the marks below
+        harness.run("metrics", "restaurant-meal", n, 0, static_cast<double>(n), "meal/s", true, [&] {
+            restaurant->initialize(n);
+            restaurant->close();
+            async_log::Logger::getInstance().flush();
+        }, 3);
+        restaurant->virtualTime = false;
+    }
+
+    auto metrics = std::make_unique<restaurant::Metrics>();
+
+    size_t calls = size_t(1) << 16;
+    harness.run("metrics", "record", calls, 0, static_cast<double>(calls), "record/s", false, [&] {
+        for (size_t i = 0; i < calls; i++)
+        {
+            metrics->total.record(i * 977);
+        }
+    });
+
+    // the clock the virtual restaurant reads
+    coro::Simulation clock;
+    clock.install();
+    auto stamp = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(coro::now().time_since_epoch()).count();
+    };
+    harness.run("metrics", "marks-per-meal", n, 0, static_cast<double>(n), "meal/s", false, [&] {
+        for (unsigned int i = 0; i < n; i++)
+        {
+            int64_t at[restaurant::stageCount + 1];
+            at[0] = stamp();
+            for (int stage = 0; stage < restaurant::stageCount; stage++)
+            {
+                at[stage + 1] = stamp();
+                metrics->record(at, restaurant::Stage(stage), restaurant::Priority(i % restaurant::priorityCount));
+            }
+        }
+    });
+#else
+    (void)harness;
+#endif
+}
+
+// Batching on a virtual clock, so the samples are simulated time: the service time gives the
+// throughput, the customers' mean wait the latency it costs. A batch saves the setup of all but
+// its first meal, and the trips to the queue: batch-pops and batch-parks count, per meal, how
+// often the cooks and the chief went to wait for work and how often they parked doing so,
+// throughput being meals per pop or park.
+void benchBatching(Harness &harness)
+{
+    // the usual ten customers, and a crowd that keeps every stage saturated
+    std::vector<unsigned int> customers =
+        harness.options().quick ? std::vector<unsigned int>{10, 100} : std::vector<unsigned int>{10, 1000};
+    size_t repeats = std::min<size_t>(harness.options().repeats, 3);
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+
+    for (unsigned int n : customers)
+    {
+        for (size_t size : {1, 2, 4, 8})
+        {
+            SilenceStdout silence;
+
+            restaurant::Batching batching{size, std::chrono::milliseconds(size > 1 ? 50 : 0)};
+            restaurant->cookBatch = batching;
+            restaurant->chiefBatch = batching;
+
+            std::vector<double> service;
+            std::vector<double> wait;
+            std::vector<double> pops;
+            std::vector<double> parks;
+            restaurant->virtualTime = true;
+            for (size_t i = 0; i < repeats; i++)
+            {
+                restaurant->initialize(n, 3);
+                restaurant->close();
+                service.push_back(std::chrono::duration<double>(restaurant->serviceTime()).count());
+                wait.push_back(std::chrono::duration<double>(restaurant->meanWait()).count());
+
+                restaurant::WaitCost cooks = restaurant->cookWaits();
+                restaurant::WaitCost chief = restaurant->chiefWaits();
+                pops.push_back(static_cast<double>(cooks.pops + chief.pops) / n);
+                parks.push_back(static_cast<double>(cooks.parks + chief.parks) / n);
+            }
+            restaurant->virtualTime = false;
+
+            std::string kernel = "batch-" + std::to_string(size);
+            harness.record("batching", kernel, n, 0, static_cast<double>(n), "meal/s", size == 1, service);
+            harness.record("batch-wait", kernel, n, 0, 1.0, "1/s", size == 1, wait);
+            harness.record("batch-pops", kernel, n, 0, 1.0, "meal/pop", size == 1, pops);
+            harness.record("batch-parks", kernel, n, 0, 1.0, "meal/park", size == 1, parks);
+        }
+    }
+
+    restaurant->cookBatch = {};
+    restaurant->chiefBatch = {};
+}
+
+// Routing policies with enough waiters that the cooks are the bottleneck, on virtual time.
+void benchRouting(Harness &harness)
+{
+    unsigned int n = harness.options().quick ? 100 : 1000;
+    size_t repeats = std::min<size_t>(harness.options().repeats, 3);
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+
+    for (restaurant::Routing routing :
+         {restaurant::Routing::RoundRobin, restaurant::Routing::ShortestQueue, restaurant::Routing::AffinityFirst})
+    {
+        SilenceStdout silence;
+
+        restaurant->routing = routing;
+
+        std::vector<double> service;
+        std::vector<double> wait;
+        simulateService(n, 8, repeats, service, wait);
+
+        std::string kernel = restaurant::routingToString(routing);
+        harness.record("routing", kernel, n, 0, static_cast<double>(n), "meal/s",
+                       routing == restaurant::Routing::RoundRobin, service);
+        harness.record("route-wait", kernel, n, 0, 1.0, "1/s", routing == restaurant::Routing::RoundRobin, wait);
+    }
+
+    restaurant->routing = restaurant::Routing::AffinityFirst;
+}
+
+// Fixed crews against the autoscaler on virtual time: the p99 of a meal's total latency next to
+// the cook and waiter time paid for, to pick the cheapest crew that meets a latency target.
+void benchStaffing(Harness &harness)
+{
+    unsigned int n = harness.options().quick ? 100 : 1000;
+    size_t repeats = std::min<size_t>(harness.options().repeats, 3);
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+    restaurant->virtualTime = true;
+
+    struct Crew
+    {
+        unsigned int cooks;
+        unsigned int waiters;
+        bool autoscale;
+    };
+
+    // autoscaling from the default crew dismisses cooks below the stations initialize() set up
+    for (Crew crew : {Crew{4, 3, false}, Crew{2, 2, false}, Crew{8, 8, false}, Crew{1, 1, true}, Crew{4, 3, true}})
+    {
+        SilenceStdout silence;
+
+        restaurant->staffing.autoscale = crew.autoscale;
+
+        std::vector<double> p99;
+        std::vector<double> paid;
+        for (size_t i = 0; i < repeats; i++)
+        {
+            restaurant->initialize(n, crew.waiters, crew.cooks);
+            restaurant->close();
+            p99.push_back(static_cast<double>(restaurant->metrics.total.percentile(0.99)) / 1e9);
+            paid.push_back(std::chrono::duration<double>(restaurant->cookTime() + restaurant->waiterTime()).count());
+        }
+
+        std::string kernel = std::to_string(crew.cooks) + "-cooks-" + std::to_string(crew.waiters) + "-waiters";
+        if (crew.autoscale)
+        {
+            kernel = crew.cooks == 1 ? "autoscale" : "autoscale-from-" + std::to_string(crew.cooks);
+        }
+        bool baseline = crew.cooks == 4 && !crew.autoscale;
+        harness.record("staffing", kernel, n, 0, 1.0, "1/s", baseline, p99);
+        harness.record("staff-cost", kernel, n, 0, 1.0, "1/s", baseline, paid);
+    }
+
+    restaurant->staffing = {};
+    restaurant->virtualTime = false;
+}
+
+// Open-loop arrivals on virtual time, the offered rate swept past what the default crew can
+// serve: the achieved throughput flattens out while the p99 of a meal's latency takes off.
+// Bursty arrivals come eight at a time at the same mean rate. Then 8/s ramped up over the
+// first 20 s, and a replayed trace alternating 10 s at 4/s with 10 s at 8/s, each next to the
+// Poisson run of the same mean rate.
+void benchLoad(Harness &harness)
+{
+    size_t repeats = std::min<size_t>(harness.options().repeats, 3);
+    std::chrono::seconds duration(harness.options().quick ? 30 : 120);
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+    restaurant->virtualTime = true;
+
+    auto measure = [&](const std::string &kernel, size_t rate, bool baseline, const load::Profile &profile) {
+        SilenceStdout silence;
+
+        std::vector<double> perMeal;
+        std::vector<double> p99;
+        for (size_t i = 0; i < repeats; i++)
+        {
+            restaurant->arrivals = profile;
+            restaurant->arrivals.seed = i + 1;
+
+            restaurant->initialize(0);
+            restaurant->close();
+
+            perMeal.push_back(1.0 / std::max(restaurant->loadReport().achievedRate(), 1e-9));
+            p99.push_back(static_cast<double>(restaurant->metrics.total.percentile(0.99)) / 1e9);
+        }
+
+        harness.record("load", kernel, rate, 0, 1.0, "meal/s", baseline, perMeal);
+        harness.record("load-p99", kernel, rate, 0, 1.0, "1/s", baseline, p99);
+    };
+
+    load::Profile profile;
+    profile.warmup = std::chrono::seconds(10);
+    profile.duration = duration;
+
+    for (load::Process process : {load::Process::Poisson, load::Process::Bursty})
+    {
+        for (size_t rate : {2, 4, 6, 8, 10})
+        {
+            profile.process = process;
+            profile.rate = static_cast<double>(rate);
+            std::string kernel = std::string(load::processToString(process)) + "-" + std::to_string(rate) + "/s";
+            measure(kernel, rate, process == load::Process::Poisson, profile);
+        }
+    }
+
+    profile.process = load::Process::Poisson;
+    profile.rate = 8.0;
+    profile.rampUp = std::chrono::seconds(20);
+    measure("poisson-8/s-ramp", 8, false, profile);
+    profile.rampUp = {};
+
+    std::ostringstream recorded;
+    recorded << "# arrival offsets in ms: 10 s at 4/s, then 10 s at 8/s, over and over" << std::endl;
+    for (int64_t at = 0; at < std::chrono::duration_cast<std::chrono::milliseconds>(profile.end()).count();)
+    {
+        at += (at / 10000) % 2 == 0 ? 250 : 125;
+        recorded << at << std::endl;
+    }
+    std::istringstream trace(recorded.str());
+    profile.process = load::Process::Trace;
+    profile.trace = load::readTrace(trace);
+    measure("trace-4-8/s", 6, false, profile);
+
+    restaurant->arrivals = {};
+    restaurant->virtualTime = false;
+}
+
+// Kitchen policies with the cooks as the bottleneck, on virtual time: a tenth of the orders are
+// high priority, three tenths low. The p99 latency of high priority meals, and of all meals.
+void benchScheduling(Harness &harness)
+{
+    size_t repeats = std::min<size_t>(harness.options().repeats, 3);
+
+    restaurant::Restaurant *restaurant = restaurant::Restaurant::getInstance();
+    restaurant->virtualTime = true;
+
+    for (restaurant::Policy policy :
+         {restaurant::Policy::Fifo, restaurant::Policy::Levels, restaurant::Policy::Deadline})
+    {
+        SilenceStdout silence;
+
+        restaurant->scheduling.policy = policy;
+        restaurant->scheduling.highShare = 0.1;
+        restaurant->scheduling.lowShare = 0.3;
+
+        std::vector<double> high;
+        std::vector<double> all;
+        for (size_t i = 0; i < repeats; i++)
+        {
+            load::Profile &arrivals = restaurant->arrivals;
+            arrivals.process = load::Process::Poisson;
+            arrivals.rate = 4.5;
+            arrivals.warmup = std::chrono::seconds(10);
+            arrivals.duration = std::chrono::seconds(harness.options().quick ? 60 : 300);
+            arrivals.seed = i + 1;
+
+            restaurant->initialize(0, 8, 2);
+            restaurant->close();
+
+            high.push_back(static_cast<double>(restaurant->metrics.byPriority[restaurant::High].percentile(0.99)) / 1e9);
+            all.push_back(static_cast<double>(restaurant->metrics.total.percentile(0.99)) / 1e9);
+        }
+
+        std::string kernel = restaurant::policyToString(policy);
+        bool baseline = policy == restaurant::Policy::Fifo;
+        harness.record("scheduling", kernel, 0, 0, 1.0, "1/s", baseline, high);
+        harness.record("sched-all", kernel, 0, 0, 1.0, "1/s", baseline, all);
+    }
+
+    restaurant->scheduling = {};
+    restaurant->arrivals = {};
+    restaurant->virtualTime = false;
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw("missing value for option");
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--format")
+            options.format = value();
+        else if (arg == "--filter")
+            options.filter = value();
+        else if (arg == "--warmup")
+            options.warmup = std::stoul(value());
+        else if (arg == "--repeats")
+            options.repeats = std::max(1ul, std::stoul(value()));
+        else if (arg == "--max-threads")
+            options.maxThreads = std::max(1ul, std::stoul(value()));
+        else if (arg == "--quick")
+            options.quick = true;
+        else
+        {
+            std::cerr << "usage: bench [--format table|csv|json] [--filter suite] [--warmup n] [--repeats n]"
+                         " [--max-threads n] [--quick]"
+                      << std::endl;
+            std::exit(arg == "--help" ? 0 : 1);
+        }
+    }
+
+    if (options.quick)
+    {
+        options.repeats = std::min<size_t>(options.repeats, 3);
+    }
+
+    return options;
+}
+
+} // namespace bench
+
+int main(int argc, char **argv)
+{
+    bench::Harness harness(bench::parseOptions(argc, argv));
+
+    if (harness.enabled("matrix"))
+        bench::benchMatrix(harness);
+    if (harness.enabled("sum"))
+        bench::benchSum(harness);
+    if (harness.enabled("accumulator"))
+        bench::benchAccumulator(harness);
+    if (harness.enabled("queue"))
+        bench::benchQueue(harness);
+    if (harness.enabled("pqueue"))
+        bench::benchPriorityQueue(harness);
+    if (harness.enabled("log"))
+        bench::benchLog(harness);
+    if (harness.enabled("count"))
+        bench::benchCount(harness);
+    if (harness.enabled({"handoff", "handoff-rtt"}))
+        bench::benchHandoff(harness);
+    if (harness.enabled("sequencer"))
+        bench::benchSequencer(harness);
+    if (harness.enabled("restaurant"))
+        bench::benchRestaurant(harness);
+    if (harness.enabled("metrics"))
+        bench::benchMetrics(harness);
+    if (harness.enabled({"batching", "batch-wait", "batch-pops", "batch-parks"}))
+        bench::benchBatching(harness);
+    if (harness.enabled({"routing", "route-wait"}))
+        bench::benchRouting(harness);
+    if (harness.enabled({"staffing", "staff-cost"}))
+        bench::benchStaffing(harness);
+    if (harness.enabled({"load", "load-p99"}))
+        bench::benchLoad(harness);
+    if (harness.enabled({"scheduling", "sched-all"}))
+        bench::benchScheduling(harness);
+
+    harness.report(std::cout);
+
+    return 0;
+}
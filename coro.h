@@ -0,0 +1,887 @@
+#ifndef CORO
+#define CORO
+
+#include "idle.h"
+#include "ring-buffer.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace coro
+{
+
+template <typename T = void> class Task;
+
+namespace detail
+{
+
+// Hands control back to whoever awaited the task. Symmetric transfer, so long chains of
+// awaits do not grow the stack.
+struct FinalAwaiter
+{
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    template <typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation{};
+    std::exception_ptr exception{};
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        exception = std::current_exception();
+    }
+};
+
+template <typename T> struct Promise : PromiseBase
+{
+    std::optional<T> value{};
+
+    Task<T> get_return_object();
+
+    template <typename U> void return_value(U &&result)
+    {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <> struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};
+
+} // namespace detail
+
+// Lazy coroutine: its body only starts once it is awaited, and it resumes the awaiter when it
+// returns. Exceptions travel to the awaiter.
+template <typename T> class Task
+{
+  public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle{handle}
+    {
+    }
+
+    Task(Task &&other) noexcept : _handle{std::exchange(other._handle, {})}
+    {
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    Task &operator=(Task &&) = delete;
+
+    ~Task()
+    {
+        if (_handle)
+            _handle.destroy();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        _handle.promise().continuation = awaiter;
+        return _handle;
+    }
+
+    T await_resume()
+    {
+        return _handle.promise().result();
+    }
+
+  private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template <typename T> Task<T> detail::Promise<T>::get_return_object()
+{
+    return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+
+inline Task<void> detail::Promise<void>::get_return_object()
+{
+    return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+}
+
+using Clock = std::chrono::steady_clock;
+
+namespace detail
+{
+
+// A coroutine due at deadline. Entries with the same deadline come out in the order they
+// went in (sequence).
+struct Deadline
+{
+    Clock::time_point deadline;
+    size_t sequence;
+    std::coroutine_handle<> handle;
+
+    bool operator>(const Deadline &other) const
+    {
+        return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+    }
+};
+
+using Deadlines = std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>;
+
+} // namespace detail
+
+// Discrete-event executor on a virtual clock. While one is installed every resume and every
+// sleep goes to it instead of the pool and the timer thread, and nothing runs until a thread
+// calls runUntil(): that thread resumes the ready coroutines one at a time and, once none are
+// left, jumps the clock straight to the next deadline.
+class Simulation
+{
+  public:
+    Simulation() = default;
+    ~Simulation()
+    {
+        uninstall();
+    }
+
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    static Simulation *current()
+    {
+        return _current.load(std::memory_order_acquire);
+    }
+
+    void install()
+    {
+        _current.store(this, std::memory_order_release);
+    }
+
+    void uninstall()
+    {
+        Simulation *self = this;
+        _current.compare_exchange_strong(self, nullptr);
+    }
+
+    // Read on every timestamp, so without the lock: only advance() moves it.
+    Clock::time_point now() const
+    {
+        return _now.load(std::memory_order_acquire);
+    }
+
+    // Virtual time since the simulation was created.
+    Clock::duration elapsed() const
+    {
+        return now() - _start;
+    }
+
+    // Coroutines resumed so far.
+    size_t events() const
+    {
+        return _events;
+    }
+
+    void post(std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _ready.push_back(handle);
+    }
+
+    void resumeAt(Clock::time_point deadline, std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _deadlines.push({deadline, _sequence++, handle});
+    }
+
+    // done() is checked whenever nothing is ready at the current instant. Returns false if
+    // the simulation runs out of events first: then done() can never become true.
+    template <typename Done> bool runUntil(Done done);
+
+  private:
+    std::coroutine_handle<> next();
+    bool advance();
+
+    static inline std::atomic<Simulation *> _current{nullptr};
+
+    std::mutex _mtx;
+    std::deque<std::coroutine_handle<>> _ready{};
+    detail::Deadlines _deadlines{};
+    size_t _sequence{0};
+    Clock::time_point _start{Clock::now()};
+    std::atomic<Clock::time_point> _now{_start};
+    size_t _events{0};
+};
+
+template <typename Done> bool Simulation::runUntil(Done done)
+{
+    for (;;)
+    {
+        while (std::coroutine_handle<> handle = next())
+        {
+            _events++;
+            handle.resume();
+        }
+
+        if (done())
+            return true;
+
+        if (!advance())
+            return false;
+    }
+}
+
+inline std::coroutine_handle<> Simulation::next()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_ready.empty())
+        return {};
+
+    std::coroutine_handle<> handle = _ready.front();
+    _ready.pop_front();
+    return handle;
+}
+
+// Everything due at the next deadline becomes ready at once, in the order it was scheduled.
+inline bool Simulation::advance()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_deadlines.empty())
+        return false;
+
+    Clock::time_point now = _deadlines.top().deadline;
+    _now.store(now, std::memory_order_release);
+    while (!_deadlines.empty() && _deadlines.top().deadline <= now)
+    {
+        _ready.push_back(_deadlines.top().handle);
+        _deadlines.pop();
+    }
+    return true;
+}
+
+// The simulation's clock while one is installed, the steady clock otherwise.
+inline Clock::time_point now()
+{
+    Simulation *simulation = Simulation::current();
+    return simulation ? simulation->now() : Clock::now();
+}
+
+namespace detail
+{
+
+inline void resume(std::coroutine_handle<> handle)
+{
+    if (Simulation *simulation = Simulation::current())
+        simulation->post(handle);
+    else
+        thread_pool::ThreadPool::getInstance().post([handle]() { handle.resume(); });
+}
+
+} // namespace detail
+
+// Resumes the awaiting coroutine on a pool worker. Also the coroutine way to yield: the
+// frame goes to the back of the queue and the worker picks up something else meanwhile.
+struct Schedule
+{
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        detail::resume(handle);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+inline Schedule schedule()
+{
+    return {};
+}
+
+namespace detail
+{
+
+// Eager and self-destroying: only used to drive a Task from plain code.
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+        void return_void() const noexcept
+        {
+        }
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+inline Detached drive(Task<void> task, std::promise<void> done)
+{
+    co_await schedule();
+    try
+    {
+        co_await task;
+        done.set_value();
+    }
+    catch (...)
+    {
+        done.set_exception(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+// Starts a task on the pool. The future is ready once it returns; it is the only way for
+// non-coroutine code to wait on one, through wait() below.
+inline std::future<void> spawn(Task<void> task)
+{
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    detail::drive(std::move(task), std::move(done));
+    return future;
+}
+
+// Waits for a spawned task. Under a simulation the waiting thread is the one driving it.
+inline void wait(std::future<void> &future)
+{
+    if (Simulation *simulation = Simulation::current())
+    {
+        bool finished = simulation->runUntil(
+            [&] { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        if (!finished)
+        {
+            throw("simulation ran out of events before the task finished");
+        }
+    }
+
+    future.wait();
+}
+
+// One thread for all sleeping coroutines: deadlines sit in a heap, due frames are posted
+// to the pool.
+class Timer
+{
+  public:
+    static Timer &getInstance();
+
+    void resumeAt(Clock::time_point deadline, std::coroutine_handle<> handle);
+
+  private:
+    Timer();
+    ~Timer();
+
+    void loop();
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    detail::Deadlines _entries{};
+    size_t _sequence{0};
+    bool _stop{false};
+
+    std::thread _thread;
+};
+
+inline Timer &Timer::getInstance()
+{
+    static Timer instance;
+    return instance;
+}
+
+inline Timer::Timer() : _thread{[this]() { loop(); }}
+{
+}
+
+inline Timer::~Timer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+inline void Timer::resumeAt(Clock::time_point deadline, std::coroutine_handle<> handle)
+{
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        earliest = _entries.empty() || deadline < _entries.top().deadline;
+        _entries.push({deadline, _sequence++, handle});
+    }
+
+    if (earliest)
+        _cv.notify_one();
+}
+
+inline void Timer::loop()
+{
+    thread_pool::ThreadPool &pool = thread_pool::ThreadPool::getInstance();
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    while (!_stop)
+    {
+        if (_entries.empty())
+        {
+            _cv.wait(lock);
+            continue;
+        }
+
+        Clock::time_point deadline = _entries.top().deadline;
+        if (Clock::now() < deadline)
+        {
+            _cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::coroutine_handle<> handle = _entries.top().handle;
+        _entries.pop();
+
+        lock.unlock();
+        pool.post([handle]() { handle.resume(); });
+        lock.lock();
+    }
+}
+
+struct Sleep
+{
+    Clock::time_point deadline;
+
+    bool await_ready() const
+    {
+        return now() >= deadline;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        if (Simulation *simulation = Simulation::current())
+            simulation->resumeAt(deadline, handle);
+        else
+            Timer::getInstance().resumeAt(deadline, handle);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+// Suspends the coroutine without holding a thread; under a simulation only virtual time passes.
+template <typename Rep, typename Period> Sleep sleep(std::chrono::duration<Rep, Period> duration)
+{
+    return {now() + std::chrono::duration_cast<Clock::duration>(duration)};
+}
+
+inline Sleep sleepUntil(Clock::time_point deadline)
+{
+    return {deadline};
+}
+
+namespace detail
+{
+
+// A parked coroutine. A timed one is also held by its timeout, and only whichever of the two
+// claims it first resumes it.
+struct Waiter
+{
+    std::coroutine_handle<> handle;
+    std::shared_ptr<std::atomic<bool>> claimed{};
+
+    bool claim() const
+    {
+        return !claimed || !claimed->exchange(true);
+    }
+};
+
+inline Detached timeout(Clock::time_point deadline, std::coroutine_handle<> handle,
+                        std::shared_ptr<std::atomic<bool>> claimed)
+{
+    co_await sleepUntil(deadline);
+    if (!claimed->exchange(true))
+        resume(handle);
+}
+
+} // namespace detail
+
+// Coroutines parked until a condition may have changed. Same protocol as RingBuffer's
+// sleepers: a waiter counts itself in and then re-checks under the lock, a notifier changes
+// the state first and then reads the count, both seq_cst.
+class WaitList
+{
+  public:
+    template <typename Ready> auto wait(Ready ready)
+    {
+        return Awaiter<Ready>{*this, std::move(ready), std::nullopt};
+    }
+
+    // Like wait(), but also resumes once deadline has passed, ready() or not.
+    template <typename Ready> auto waitUntil(Ready ready, Clock::time_point deadline)
+    {
+        return Awaiter<Ready>{*this, std::move(ready), deadline};
+    }
+
+    void notifyOne()
+    {
+        if (_count.load() == 0)
+            return;
+
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            for (bool claimed = false; !claimed;)
+            {
+                if (_waiters.empty())
+                    return;
+                handle = _waiters.front().handle;
+                claimed = _waiters.front().claim();
+                _waiters.pop_front();
+                _count.fetch_sub(1);
+            }
+        }
+        detail::resume(handle);
+    }
+
+    void notifyAll()
+    {
+        std::deque<detail::Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            waiters.swap(_waiters);
+            _count.fetch_sub(waiters.size());
+        }
+
+        for (const detail::Waiter &waiter : waiters)
+        {
+            if (waiter.claim())
+                detail::resume(waiter.handle);
+        }
+    }
+
+  private:
+    template <typename Ready> struct Awaiter
+    {
+        WaitList &list;
+        Ready ready;
+        std::optional<Clock::time_point> deadline;
+        std::shared_ptr<std::atomic<bool>> claimed{};
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // The frame may be resumed as soon as it is listed, so only locals are used after that.
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            std::shared_ptr<std::atomic<bool>> timed;
+            Clock::time_point due{};
+            {
+                std::lock_guard<std::mutex> lock(list._mtx);
+                list._count.fetch_add(1);
+                if (ready() || (deadline && now() >= *deadline))
+                {
+                    list._count.fetch_sub(1);
+                    return false;
+                }
+                if (deadline)
+                {
+                    claimed = std::make_shared<std::atomic<bool>>(false);
+                    timed = claimed;
+                    due = *deadline;
+                }
+                list._waiters.push_back({handle, claimed});
+            }
+
+            if (timed)
+                detail::timeout(due, handle, std::move(timed));
+            return true;
+        }
+
+        void await_resume()
+        {
+            if (claimed)
+                list.forget(claimed);
+        }
+    };
+
+    // A timed waiter resumed by its timeout is still listed: take it out.
+    void forget(const std::shared_ptr<std::atomic<bool>> &claimed)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto it = std::find_if(_waiters.begin(), _waiters.end(),
+                               [&](const detail::Waiter &waiter) { return waiter.claimed == claimed; });
+        if (it != _waiters.end())
+        {
+            _waiters.erase(it);
+            _count.fetch_sub(1);
+        }
+    }
+
+    std::mutex _mtx;
+    std::deque<detail::Waiter> _waiters{};
+    std::atomic<size_t> _count{0};
+};
+
+// The coroutine take on idle::Strategy::wait: retries poll() while spinning, then rescheduling
+// itself, then parked on list until ready() holds. Whoever makes ready() true notifies list.
+// Returns false once finished() says there is nothing left to poll for.
+template <typename Poll, typename Ready, typename Finished>
+Task<bool> waitFor(WaitList &list, Poll poll, Ready ready, Finished finished, const idle::Strategy &strategy,
+                   idle::Counters *counters)
+{
+    std::atomic<size_t> idle::Counters::*how = &idle::Counters::immediate;
+    size_t spins = 0;
+    size_t yields = 0;
+
+    for (;;)
+    {
+        if (poll())
+        {
+            idle::Strategy::ran(counters, how);
+            co_return true;
+        }
+
+        if (finished())
+            co_return false;
+
+        if (spins < strategy.spinCount)
+        {
+            spins++;
+            how = &idle::Counters::spins;
+            idle::cpuRelax();
+        }
+        else if (yields < strategy.yieldCount)
+        {
+            yields++;
+            how = &idle::Counters::yields;
+            co_await schedule();
+        }
+        else
+        {
+            how = &idle::Counters::parks;
+            co_await list.wait(ready);
+        }
+    }
+}
+
+// Bounded channel for coroutines on top of RingBuffer: the fast path is the ring's lock-free
+// push and pop, a coroutine that has to wait parks its frame, not its thread.
+template <typename T> class Channel
+{
+  public:
+    explicit Channel(size_t capacity) : _buffer{capacity}
+    {
+    }
+
+    // Waits for room while the channel is full; false once it is closed.
+    Task<bool> push(T value);
+    bool tryPush(T value);
+
+    // Waits for a value while the channel is empty, spinning and rescheduling itself first as
+    // the strategy says; nullopt once it is closed and drained. strategy must outlive the call.
+    Task<std::optional<T>> pop(const idle::Strategy &strategy = idle::parkAtOnce, idle::Counters *counters = nullptr);
+    bool tryPop(T &value);
+
+    // Waits for one value like pop(), then appends whatever else is ready, up to max values in
+    // all. Returns how many it took: 0 once the channel is closed and drained.
+    Task<size_t> popBatch(std::vector<T> &out, size_t max, const idle::Strategy &strategy = idle::parkAtOnce,
+                          idle::Counters *counters = nullptr);
+    size_t tryPopBatch(std::vector<T> &out, size_t max);
+
+    // Appends values as they arrive, up to max of them, until deadline or close(). Returns how
+    // many it took, as soon as it has max.
+    Task<size_t> popBatchUntil(std::vector<T> &out, size_t max, Clock::time_point deadline);
+
+    void close()
+    {
+        _buffer.close();
+        _notEmpty.notifyAll();
+        _notFull.notifyAll();
+    }
+
+    bool isClosed() const
+    {
+        return _buffer.isClosed();
+    }
+
+    size_t size() const
+    {
+        return _buffer.size();
+    }
+
+    bool empty() const
+    {
+        return _buffer.empty();
+    }
+
+    size_t capacity() const
+    {
+        return _buffer.capacity();
+    }
+
+  private:
+    ring_buffer::RingBuffer<T> _buffer;
+    WaitList _notEmpty;
+    WaitList _notFull;
+};
+
+template <typename T> bool Channel<T>::tryPush(T value)
+{
+    if (!_buffer.tryPush(std::move(value)))
+        return false;
+
+    _notEmpty.notifyOne();
+    return true;
+}
+
+template <typename T> bool Channel<T>::tryPop(T &value)
+{
+    if (!_buffer.tryPop(value))
+        return false;
+
+    _notFull.notifyOne();
+    return true;
+}
+
+template <typename T> size_t Channel<T>::tryPopBatch(std::vector<T> &out, size_t max)
+{
+    size_t taken = 0;
+    T value;
+    while (taken < max && tryPop(value))
+    {
+        out.push_back(std::move(value));
+        taken++;
+    }
+    return taken;
+}
+
+template <typename T>
+Task<size_t> Channel<T>::popBatch(std::vector<T> &out, size_t max, const idle::Strategy &strategy,
+                                  idle::Counters *counters)
+{
+    if (max == 0)
+        co_return 0;
+
+    std::optional<T> first = co_await pop(strategy, counters);
+    if (!first)
+        co_return 0;
+
+    out.push_back(std::move(*first));
+    co_return 1 + tryPopBatch(out, max - 1);
+}
+
+template <typename T>
+Task<size_t> Channel<T>::popBatchUntil(std::vector<T> &out, size_t max, Clock::time_point deadline)
+{
+    size_t taken = 0;
+    for (;;)
+    {
+        taken += tryPopBatch(out, max - taken);
+        if (taken == max || _buffer.isClosed() || now() >= deadline)
+            co_return taken;
+
+        co_await _notEmpty.waitUntil([this] { return !_buffer.empty() || _buffer.isClosed(); }, deadline);
+    }
+}
+
+template <typename T> Task<bool> Channel<T>::push(T value)
+{
+    for (;;)
+    {
+        if (_buffer.isClosed())
+            co_return false;
+
+        if (_buffer.tryPush(std::move(value)))
+        {
+            _notEmpty.notifyOne();
+            co_return true;
+        }
+
+        co_await _notFull.wait([this] { return _buffer.size() < _buffer.capacity() || _buffer.isClosed(); });
+    }
+}
+
+template <typename T> Task<std::optional<T>> Channel<T>::pop(const idle::Strategy &strategy, idle::Counters *counters)
+{
+    T value;
+    bool popped = co_await waitFor(
+        _notEmpty, [&] { return tryPop(value); }, [this] { return !_buffer.empty() || _buffer.isClosed(); },
+        [this] { return _buffer.isClosed() && _buffer.empty(); }, strategy, counters);
+
+    if (!popped)
+        co_return std::nullopt;
+    co_return std::optional<T>{std::move(value)};
+}
+
+} // namespace coro
+
+#endif
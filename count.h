@@ -1,55 +1,266 @@
 #ifndef COUNT
 #define COUNT
 
-#include <condition_variable>
+#include "idle.h"
+#include "ring-buffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <ostream>
 #include <thread>
+#include <vector>
 
 namespace count
 {
 
-std::condition_variable cv;
-bool isEvenTurn{true};
-std::mutex mtx;
+// Turn-taking in a fixed ring: participant 0, 1, ..., n - 1, then 0 again. A participant calls
+// wait(i), does its part, then pass(i) to hand the turn to the next one. Waiting spins, yields,
+// then parks on the atomic itself (a futex), and pass() only issues the wakeup when someone is
+// parked, so a handoff between two busy cores never enters the kernel.
 
-inline void countEven(int end, int &count)
+// One shared sequence number, the turn belongs to participant seq % n. Every waiter reads the
+// same line, so a pass wakes all parked participants to let one of them through.
+class TurnCounter
 {
-    while (count < end)
+  public:
+    explicit TurnCounter(size_t participants, idle::Strategy strategy = {})
+        : _participants{participants == 0 ? 1 : participants}, _strategy{strategy}
     {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [] { return isEvenTurn; });
+    }
 
-        std::cout << count << ", ";
-        count++;
-        isEvenTurn = false;
+    TurnCounter(const TurnCounter &) = delete;
+    TurnCounter &operator=(const TurnCounter &) = delete;
 
-        cv.notify_one();
+    // Returns the sequence number of the turn, counting every participant's.
+    uint64_t wait(size_t participant)
+    {
+        uint64_t seq = 0;
+        auto mine = [&] {
+            seq = _seq.load(std::memory_order_seq_cst);
+            return seq % _participants == participant;
+        };
+        _strategy.wait(mine, [&] {
+            _parked.fetch_add(1, std::memory_order_seq_cst);
+            while (!mine())
+            {
+                _seq.wait(seq, std::memory_order_seq_cst);
+            }
+            _parked.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        });
+        return seq;
+    }
+
+    void pass(size_t)
+    {
+        _seq.fetch_add(1, std::memory_order_seq_cst);
+        if (_parked.load(std::memory_order_seq_cst) > 0)
+        {
+            _seq.notify_all();
+        }
     }
-}
 
-inline void countUneven(int end, int &count)
+    size_t participants() const
+    {
+        return _participants;
+    }
+
+  private:
+    size_t _participants;
+    idle::Strategy _strategy;
+    alignas(ring_buffer::cacheLine) std::atomic<uint64_t> _seq{0};
+    alignas(ring_buffer::cacheLine) std::atomic<uint32_t> _parked{0};
+};
+
+// One flag per participant, each on its own cache line. Only the predecessor sets it and only
+// its owner clears it, so a handoff moves one line between two cores and wakes exactly the
+// participant whose turn it is.
+class TurnFlags
 {
-    while (count < end)
+  public:
+    explicit TurnFlags(size_t participants, idle::Strategy strategy = {})
+        : _participants{participants == 0 ? 1 : participants}, _strategy{strategy}, _flags{new Flag[_participants]}
     {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [] { return !isEvenTurn; });
+        _flags[0].go.store(1, std::memory_order_relaxed);
+    }
 
-        std::cout << count << ", ";
-        count++;
-        isEvenTurn = true;
+    TurnFlags(const TurnFlags &) = delete;
+    TurnFlags &operator=(const TurnFlags &) = delete;
 
-        cv.notify_one();
+    void wait(size_t participant)
+    {
+        Flag &flag = _flags[participant];
+        auto mine = [&] { return flag.go.load(std::memory_order_seq_cst) != 0; };
+        _strategy.wait(mine, [&] {
+            flag.parked.store(1, std::memory_order_seq_cst);
+            while (!mine())
+            {
+                flag.go.wait(0, std::memory_order_seq_cst);
+            }
+            flag.parked.store(0, std::memory_order_relaxed);
+            return true;
+        });
+        flag.go.store(0, std::memory_order_relaxed);
     }
-}
 
-inline void parallel()
+    void pass(size_t participant)
+    {
+        Flag &next = _flags[(participant + 1) % _participants];
+        next.go.store(1, std::memory_order_seq_cst);
+        if (next.parked.load(std::memory_order_seq_cst) != 0)
+        {
+            next.go.notify_one();
+        }
+    }
+
+    size_t participants() const
+    {
+        return _participants;
+    }
+
+  private:
+    struct alignas(ring_buffer::cacheLine) Flag
+    {
+        std::atomic<uint32_t> go{0};
+        std::atomic<uint32_t> parked{0};
+    };
+
+    size_t _participants;
+    idle::Strategy _strategy;
+    std::unique_ptr<Flag[]> _flags;
+};
+
+// K threads counting up to end in a fixed order: thread 0 counts 0, thread 1 counts 1, ...,
+// thread K - 1 counts K - 1, then thread 0 again. The counter is only touched in a thread's
+// turn, and each thread writes what it counted to its own buffer; write() merges the buffers
+// back in counting order afterwards, so nothing is printed while the turn is held. The threads
+// are started once and park between runs, so run() pays for the handoffs, not for spawning.
+class Sequencer
 {
-    int count{0};
-    std::thread t0(countEven, 1000, std::ref(count));
-    std::thread t1(countUneven, 1000, std::ref(count));
+  public:
+    explicit Sequencer(size_t threads, idle::Strategy strategy = {})
+        : _strategy{strategy}, _buffers(threads == 0 ? 1 : threads)
+    {
+        for (size_t i = 0; i < _buffers.size(); i++)
+        {
+            _threads.emplace_back([this, i] { serve(i); });
+        }
+    }
+
+    Sequencer(const Sequencer &) = delete;
+    Sequencer &operator=(const Sequencer &) = delete;
 
-    t0.join();
-    t1.join();
+    ~Sequencer()
+    {
+        _stop = true;
+        _generation.fetch_add(1, std::memory_order_release);
+        _generation.notify_all();
+        for (std::thread &thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Lets the threads count until the counter reaches end and waits for all of them; returns
+    // the count. Each run starts from thread 0 with a fresh ring.
+    int run(int end)
+    {
+        _turns = std::make_unique<TurnFlags>(_buffers.size(), _strategy);
+        _end = end;
+        _count = 0;
+        for (Buffer &buffer : _buffers)
+        {
+            buffer.counted.clear();
+        }
+
+        _running.store(_buffers.size(), std::memory_order_relaxed);
+        _generation.fetch_add(1, std::memory_order_release);
+        _generation.notify_all();
+
+        for (size_t running; (running = _running.load(std::memory_order_acquire)) != 0;)
+        {
+            _running.wait(running, std::memory_order_acquire);
+        }
+        return _count;
+    }
+
+    // Everything the last run() counted, in order, as "0, 1, 2, ".
+    void write(std::ostream &os) const
+    {
+        for (size_t round = 0;; round++)
+        {
+            for (const Buffer &buffer : _buffers)
+            {
+                if (round >= buffer.counted.size())
+                    return;
+                os << buffer.counted[round] << ", ";
+            }
+        }
+    }
+
+    size_t threads() const
+    {
+        return _buffers.size();
+    }
+
+  private:
+    struct alignas(ring_buffer::cacheLine) Buffer
+    {
+        std::vector<int> counted{};
+    };
+
+    // Parks until run() or the destructor bumps the generation, then takes part in the run.
+    void serve(size_t thread)
+    {
+        for (uint64_t seen = 0;;)
+        {
+            _generation.wait(seen, std::memory_order_acquire);
+            seen = _generation.load(std::memory_order_acquire);
+            if (_stop)
+                return;
+
+            take(*_turns, thread, _end);
+            if (_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                _running.notify_one();
+            }
+        }
+    }
+
+    void take(TurnFlags &turns, size_t thread, int end)
+    {
+        std::vector<int> &counted = _buffers[thread].counted;
+        for (bool done = false; !done;)
+        {
+            turns.wait(thread);
+            done = _count >= end;
+            if (!done)
+            {
+                counted.push_back(_count++);
+            }
+            turns.pass(thread);
+        }
+    }
+
+    idle::Strategy _strategy;
+    std::vector<Buffer> _buffers;
+    std::unique_ptr<TurnFlags> _turns{};
+    int _end{0};
+    int _count{0};
+    bool _stop{false};
+    alignas(ring_buffer::cacheLine) std::atomic<uint64_t> _generation{0};
+    alignas(ring_buffer::cacheLine) std::atomic<size_t> _running{0};
+    std::vector<std::thread> _threads{};
+};
+
+inline void parallel()
+{
+    Sequencer sequencer(2);
+    sequencer.run(1000);
+    sequencer.write(std::cout);
 }
 
 } // namespace count
@@ -1,8 +1,9 @@
 #ifndef DOUBLE_HELLO
 #define DOUBLE_HELLO
 
+#include "thread-pool.h"
+
 #include <iostream>
-#include <thread>
 
 namespace say_hello
 {
@@ -14,13 +15,15 @@ inline void sayHello()
 
 inline void parallel()
 {
-    std::thread t0(sayHello);
-    std::thread t1(sayHello);
-    std::thread t2(sayHello);
+    thread_pool::ThreadPool &pool = thread_pool::ThreadPool::getInstance();
+
+    auto t0 = pool.submit(sayHello);
+    auto t1 = pool.submit(sayHello);
+    auto t2 = pool.submit(sayHello);
 
-    t0.join();
-    t1.join();
-    t2.join();
+    pool.wait(t0);
+    pool.wait(t1);
+    pool.wait(t2);
 }
 
 } // namespace say_hello
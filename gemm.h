@@ -0,0 +1,178 @@
+#ifndef GEMM
+#define GEMM
+
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace gemm
+{
+
+// Register tile computed by the micro-kernel: MR rows of A against NR columns of B.
+constexpr size_t MR = 4;
+constexpr size_t NR = 8;
+
+// Cache tiles: an MR x KC sliver of A and a KC x NR sliver of B stay in L1,
+// the packed MC x KC block of A stays in L2 and the KC x NC panel of B in L2/L3.
+constexpr size_t KC = 256;
+constexpr size_t MC = 64;
+constexpr size_t NC = 256;
+
+// Per-thread packing buffers, allocated once per pool worker and reused for every tile.
+struct Workspace
+{
+    Workspace() : packedA(MC * KC), packedB(KC * NC)
+    {
+    }
+
+    std::vector<double> packedA;
+    std::vector<double> packedB;
+};
+
+// Strided view of a matrix operand: element (row, col) lives at data[row * rowStride + col * colStride],
+// which covers both row-major and column-major storage.
+template <typename T> struct Operand
+{
+    T *data;
+    size_t rowStride;
+    size_t colStride;
+
+    T &operator()(size_t row, size_t col) const
+    {
+        return data[row * rowStride + col * colStride];
+    }
+    Operand offset(size_t row, size_t col) const
+    {
+        return {&(*this)(row, col), rowStride, colStride};
+    }
+};
+
+// Packs an mc x kc block of A into MR-row slivers, each stored column by column.
+// Rows past mc are zero-filled so the micro-kernel never needs an edge case on its inputs.
+inline void packA(Operand<const double> a, size_t mc, size_t kc, double *packed)
+{
+    for (size_t i = 0; i < mc; i += MR)
+    {
+        size_t rows = std::min(MR, mc - i);
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t r = 0; r < MR; r++)
+            {
+                *packed++ = r < rows ? a(i + r, p) : 0.0;
+            }
+        }
+    }
+}
+
+// Packs a kc x nc panel of B into NR-column slivers, each stored row by row.
+inline void packB(Operand<const double> b, size_t kc, size_t nc, double *packed)
+{
+    for (size_t j = 0; j < nc; j += NR)
+    {
+        size_t cols = std::min(NR, nc - j);
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t c = 0; c < NR; c++)
+            {
+                *packed++ = c < cols ? b(p, j + c) : 0.0;
+            }
+        }
+    }
+}
+
+// C[mr x nr] += packedA[MR x kc] * packedB[kc x NR], accumulated in registers.
+inline void microKernel(size_t kc, const double *a, const double *b, Operand<double> c, size_t mr, size_t nr)
+{
+    double acc[MR][NR] = {};
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        for (size_t r = 0; r < MR; r++)
+        {
+            double ar = a[p * MR + r];
+
+            for (size_t col = 0; col < NR; col++)
+            {
+                acc[r][col] += ar * b[p * NR + col];
+            }
+        }
+    }
+
+    for (size_t r = 0; r < mr; r++)
+    {
+        for (size_t col = 0; col < nr; col++)
+        {
+            c(r, col) += acc[r][col];
+        }
+    }
+}
+
+// Computes one MC x NC tile of C = A * B, walking the shared dimension in KC steps.
+inline void computeTile(Operand<const double> a, Operand<const double> b, Operand<double> c, size_t mc, size_t nc,
+                        size_t k, Workspace &ws)
+{
+    for (size_t pc = 0; pc < k; pc += KC)
+    {
+        size_t kc = std::min(KC, k - pc);
+
+        packB(b.offset(pc, 0), kc, nc, ws.packedB.data());
+        packA(a.offset(0, pc), mc, kc, ws.packedA.data());
+
+        for (size_t jr = 0; jr < nc; jr += NR)
+        {
+            size_t nr = std::min(NR, nc - jr);
+
+            for (size_t ir = 0; ir < mc; ir += MR)
+            {
+                size_t mr = std::min(MR, mc - ir);
+
+                microKernel(kc, ws.packedA.data() + ir * kc, ws.packedB.data() + jr * kc, c.offset(ir, jr), mr, nr);
+            }
+        }
+    }
+}
+
+// C (m x n) = A (m x k) * B (k x n), each operand in its own layout.
+// Output tiles are independent, so they are spread over the thread pool and no two
+// tasks ever touch the same part of C.
+inline void multiply(Operand<const double> a, Operand<const double> b, Operand<double> c, size_t m, size_t n,
+                     size_t k)
+{
+    for (size_t i = 0; i < m; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            c(i, j) = 0.0;
+        }
+    }
+
+    if (m == 0 || n == 0 || k == 0)
+    {
+        return;
+    }
+
+    size_t tileRows = (m + MC - 1) / MC;
+    size_t tileCols = (n + NC - 1) / NC;
+
+    thread_pool::ThreadPool::getInstance().parallelFor(
+        0, tileRows * tileCols,
+        [&](size_t t) {
+            static thread_local Workspace ws;
+
+            size_t ic = (t / tileCols) * MC;
+            size_t jc = (t % tileCols) * NC;
+            size_t mc = std::min(MC, m - ic);
+            size_t nc = std::min(NC, n - jc);
+
+            computeTile(a.offset(ic, 0), b.offset(0, jc), c.offset(ic, jc), mc, nc, k, ws);
+        },
+        1);
+}
+
+} // namespace gemm
+
+#endif
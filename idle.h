@@ -0,0 +1,87 @@
+#ifndef IDLE
+#define IDLE
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace idle
+{
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// runs counts the work an actor picked up, the rest how it got there: right away, while
+// spinning, while yielding, or only after parking.
+struct Counters
+{
+    std::atomic<size_t> runs{0};
+    std::atomic<size_t> immediate{0};
+    std::atomic<size_t> spins{0};
+    std::atomic<size_t> yields{0};
+    std::atomic<size_t> parks{0};
+};
+
+// Spin a little, then yield the core, then park. Spinning only pays off when work is about to
+// arrive on another core; parking costs a wakeup but leaves the core to everyone else.
+struct Strategy
+{
+    size_t spinCount{64};
+    size_t yieldCount{8};
+
+    // poll() tries to take work without blocking, park() blocks until there is some (or the
+    // source is closed) and returns whether it got any.
+    template <typename Poll, typename Park> bool wait(Poll &&poll, Park &&park, Counters *counters = nullptr) const
+    {
+        if (poll())
+        {
+            return ran(counters, &Counters::immediate);
+        }
+
+        for (size_t i = 0; i < spinCount; i++)
+        {
+            cpuRelax();
+            if (poll())
+            {
+                return ran(counters, &Counters::spins);
+            }
+        }
+
+        for (size_t i = 0; i < yieldCount; i++)
+        {
+            std::this_thread::yield();
+            if (poll())
+            {
+                return ran(counters, &Counters::yields);
+            }
+        }
+
+        if (!park())
+        {
+            return false;
+        }
+        return ran(counters, &Counters::parks);
+    }
+
+    // Records one run picked up the way how says; returns true for the caller's convenience.
+    static bool ran(Counters *counters, std::atomic<size_t> Counters::*how)
+    {
+        if (counters)
+        {
+            counters->runs.fetch_add(1, std::memory_order_relaxed);
+            (counters->*how).fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+};
+
+// Parks straight away: for threads that wait long and have nothing to gain from spinning.
+constexpr Strategy parkAtOnce{0, 0};
+
+} // namespace idle
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef LOAD
+#define LOAD
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace load
+{
+
+using Duration = std::chrono::nanoseconds;
+
+enum class Process
+{
+    Closed,  // no arrivals: whoever is seated at the start is all there is
+    Poisson, // one at a time, exponential gaps
+    Bursty,  // groups of burst at once, the groups Poisson, the same mean rate
+    Trace,   // replays recorded arrival offsets, ignoring rate and rampUp
+};
+
+inline const char *processToString(Process process)
+{
+    switch (process)
+    {
+    case Process::Poisson:
+        return "poisson";
+    case Process::Bursty:
+        return "bursty";
+    case Process::Trace:
+        return "trace";
+    default:
+        return "closed";
+    }
+}
+
+// Offered load, open loop: arrivals keep coming whatever the service is doing. The rate
+// climbs linearly from zero over rampUp, then holds. The first warmup is left out of the
+// measurement, which lasts duration; nobody arrives after that.
+struct Profile
+{
+    Process process{Process::Closed};
+    double rate{5.0}; // arrivals per second
+    size_t burst{8};
+
+    std::chrono::milliseconds rampUp{0};
+    std::chrono::milliseconds warmup{0};
+    std::chrono::milliseconds duration{std::chrono::seconds(10)};
+
+    // Offsets from the start, sorted, for Process::Trace.
+    std::vector<Duration> trace{};
+
+    uint64_t seed{1};
+
+    double rateAt(Duration at) const
+    {
+        if (rampUp.count() <= 0 || at >= rampUp)
+            return rate;
+        return rate * std::chrono::duration<double>(at) / std::chrono::duration<double>(rampUp);
+    }
+
+    Duration end() const
+    {
+        return warmup + duration;
+    }
+};
+
+// One offset in milliseconds per line, blank lines and lines starting with # skipped.
+inline std::vector<Duration> readTrace(std::istream &in)
+{
+    std::vector<Duration> trace;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::chrono::duration<double, std::milli> offset{std::stod(line)};
+        trace.push_back(std::chrono::duration_cast<Duration>(offset));
+    }
+    std::sort(trace.begin(), trace.end());
+    return trace;
+}
+
+// Walks a profile's arrivals in order. A ramp is followed by thinning: candidates come at the
+// full rate and each is kept with probability rateAt() / rate, which is exactly a Poisson
+// process of the ramped rate.
+class Arrivals
+{
+  public:
+    explicit Arrivals(const Profile &profile) : _profile{profile}, _random{profile.seed}
+    {
+    }
+
+    // Offset of the next arrival from the start and how many arrive together; false once the
+    // profile is over.
+    bool next(Duration &at, size_t &count)
+    {
+        switch (_profile.process)
+        {
+        case Process::Poisson:
+            count = 1;
+            return nextPoisson(_profile.rate, at);
+        case Process::Bursty:
+            count = std::max<size_t>(_profile.burst, 1);
+            return nextPoisson(_profile.rate / count, at);
+        case Process::Trace:
+            count = 1;
+            if (_traced >= _profile.trace.size() || _profile.trace[_traced] >= _profile.end())
+                return false;
+            at = _profile.trace[_traced++];
+            return true;
+        default:
+            return false;
+        }
+    }
+
+  private:
+    bool nextPoisson(double rate, Duration &at)
+    {
+        if (rate <= 0)
+            return false;
+
+        std::exponential_distribution<double> gap(rate);
+        std::uniform_real_distribution<double> keep(0.0, 1.0);
+        do
+        {
+            _at += std::chrono::duration_cast<Duration>(std::chrono::duration<double>(gap(_random)));
+            if (_at >= _profile.end())
+                return false;
+        } while (keep(_random) * _profile.rate > _profile.rateAt(_at));
+
+        at = _at;
+        return true;
+    }
+
+    const Profile &_profile;
+    std::mt19937_64 _random;
+    Duration _at{0};
+    size_t _traced{0};
+};
+
+// What was offered and what got through, over the measured window.
+struct Report
+{
+    size_t offered{0};
+    size_t turnedAway{0};
+    size_t served{0};
+    Duration window{0};
+
+    double offeredRate() const
+    {
+        return window.count() <= 0 ? 0.0 : offered / std::chrono::duration<double>(window).count();
+    }
+
+    double achievedRate() const
+    {
+        return window.count() <= 0 ? 0.0 : served / std::chrono::duration<double>(window).count();
+    }
+};
+
+} // namespace load
+
+#endif
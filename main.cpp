@@ -50,6 +50,9 @@ int main()
     std::cout << "Table : " << str(table.begin(), table.end()) << std::endl;
     std::cout << "Sum (sequencial): " << sum_of_table::sequencial(table) << std::endl;
     std::cout << "Sum (parallel): " << sum_of_table::parallel(table, 9) << std::endl;
+    std::cout << "Sum (simd): " << sum_of_table::simd(table) << std::endl;
+    std::cout << "Sum (parallel simd): " << sum_of_table::parallelSimd(table, 3) << std::endl;
+    std::cout << "Sum (parallel deterministic): " << sum_of_table::parallelDeterministic(table, 4) << std::endl;
     std::cout << "Sum (parallel mutex): " << sum_of_table::parallelMutex(table, 5) << std::endl;
 
     std::cout << std::endl << std::endl;
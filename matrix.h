@@ -1,9 +1,12 @@
 #ifndef MATRIX
 #define MATRIX
 
+#include "gemm.h"
+
+#include <algorithm>
 #include <cstddef>
 #include <iostream>
-#include <thread>
+#include <new>
 #include <vector>
 
 namespace matrix
@@ -14,17 +17,105 @@ inline int nearestFour(int n)
     return (n + 3) & ~3;
 }
 
+enum class Layout
+{
+    RowMajor,
+    ColMajor,
+};
+
+// Hands out storage aligned on a cache line, so rows start where SIMD loads want them.
+template <typename T, size_t Alignment = 64> struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U> struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+    void deallocate(T *p, size_t)
+    {
+        ::operator delete(p, std::align_val_t{Alignment});
+    }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment> &) const
+    {
+        return true;
+    }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment> &) const
+    {
+        return false;
+    }
+};
+
+// Non-owning, strided window over the elements of one row or one column of a Matrix.
+class StridedView
+{
+  public:
+    StridedView(const double *data, int size, size_t stride) : _data{data}, _size{size}, _stride{stride}
+    {
+    }
+
+    double operator[](int i) const
+    {
+        return _data[i * _stride];
+    }
+    int size() const
+    {
+        return _size;
+    }
+    size_t stride() const
+    {
+        return _stride;
+    }
+    const double *data() const
+    {
+        return _data;
+    }
+
+  private:
+    const double *_data;
+    int _size;
+    size_t _stride;
+};
+
+class RowView : public StridedView
+{
+    using StridedView::StridedView;
+};
+
+class ColView : public StridedView
+{
+    using StridedView::StridedView;
+};
+
 class Matrix
 {
   public:
-    Matrix(int cols, int rows) : _rows{rows}, _cols{cols}
+    Matrix(int cols, int rows, Layout layout = Layout::RowMajor)
+        : _rows{rows}, _cols{cols}, _layout{layout}, _rowStride{layout == Layout::RowMajor ? size_t(cols) : 1},
+          _colStride{layout == Layout::RowMajor ? 1 : size_t(rows)}, _data(static_cast<size_t>(rows) * cols)
     {
-        _data.resize(100);
     }
+
+    Matrix(const Matrix &) = default;
+    Matrix &operator=(const Matrix &) = default;
+    Matrix(Matrix &&) noexcept = default;
+    Matrix &operator=(Matrix &&) noexcept = default;
+
     double &operator()(int i, int j);
     double operator()(int i, int j) const;
-    std::vector<double> getCol(int i) const;
-    std::vector<double> getRow(int i) const;
+    ColView getCol(int i) const;
+    RowView getRow(int j) const;
 
     int getColSize() const
     {
@@ -35,12 +126,47 @@ class Matrix
         return _rows;
     }
 
+    Layout getLayout() const
+    {
+        return _layout;
+    }
+    // distance between two consecutive rows, and between two consecutive columns
+    size_t getRowStride() const
+    {
+        return _rowStride;
+    }
+    size_t getColStride() const
+    {
+        return _colStride;
+    }
+
+    double *data()
+    {
+        return _data.data();
+    }
+    const double *data() const
+    {
+        return _data.data();
+    }
+
+    gemm::Operand<double> operand()
+    {
+        return {_data.data(), _rowStride, _colStride};
+    }
+    gemm::Operand<const double> operand() const
+    {
+        return {_data.data(), _rowStride, _colStride};
+    }
+
     friend std::ostream &operator<<(std::ostream &os, const Matrix &m);
 
   private:
     int _rows;
     int _cols;
-    std::vector<double> _data{};
+    Layout _layout;
+    size_t _rowStride;
+    size_t _colStride;
+    std::vector<double, AlignedAllocator<double>> _data;
 };
 
 inline Matrix parallel(const Matrix &a, const Matrix &b);
@@ -59,21 +185,40 @@ inline std::ostream &operator<<(std::ostream &os, const Matrix &m)
     return os;
 }
 
-inline double operator*(const std::vector<double> &&a, const std::vector<double> &&b)
+// Row times column, read in place through both strides.
+inline double dot(RowView a, ColView b)
 {
-    double r{0.0};
-
     if (a.size() != b.size())
     {
         throw("cannot multiply vectors of different sizes");
     }
 
-    for (int i = 0; i < a.size(); i++)
+    const double *pa = a.data();
+    const double *pb = b.data();
+    size_t sa = a.stride();
+    size_t sb = b.stride();
+
+    double r0{0.0}, r1{0.0}, r2{0.0}, r3{0.0};
+    int i = 0;
+
+    for (; i + 4 <= a.size(); i += 4)
     {
-        r += a[i] * b[i];
+        r0 += pa[i * sa] * pb[i * sb];
+        r1 += pa[(i + 1) * sa] * pb[(i + 1) * sb];
+        r2 += pa[(i + 2) * sa] * pb[(i + 2) * sb];
+        r3 += pa[(i + 3) * sa] * pb[(i + 3) * sb];
     }
+    for (; i < a.size(); i++)
+    {
+        r0 += pa[i * sa] * pb[i * sb];
+    }
+
+    return (r0 + r1) + (r2 + r3);
+}
 
-    return r;
+inline double operator*(RowView a, ColView b)
+{
+    return dot(a, b);
 }
 
 inline Matrix operator*(const Matrix &a, const Matrix &b)
@@ -81,38 +226,24 @@ inline Matrix operator*(const Matrix &a, const Matrix &b)
     return matrix::parallel(a, b);
 }
 
-inline std::vector<double> Matrix::getCol(int i) const
+inline ColView Matrix::getCol(int i) const
 {
-    std::vector<double> col(_rows);
-
-    for (int j = 0; j < _rows; j++)
-    {
-        col.push_back((*this)(i, j));
-    }
-
-    return col;
+    return ColView(_data.data() + i * _colStride, _rows, _rowStride);
 }
 
-inline std::vector<double> Matrix::getRow(int j) const
+inline RowView Matrix::getRow(int j) const
 {
-    std::vector<double> row(_cols);
-
-    for (int i = 0; i < _cols; i++)
-    {
-        row.push_back((*this)(i, j));
-    }
-
-    return row;
+    return RowView(_data.data() + j * _rowStride, _cols, _colStride);
 }
 
 inline double &Matrix::operator()(int i, int j)
 {
-    return _data[i * _cols + j];
+    return _data[j * _rowStride + i * _colStride];
 }
 
 inline double Matrix::operator()(int i, int j) const
 {
-    return _data[i * _cols + j];
+    return _data[j * _rowStride + i * _colStride];
 }
 
 class CalcIndex
@@ -122,7 +253,7 @@ class CalcIndex
 
     void operator()()
     {
-        (*_m)(_i, _j) = _a.getRow(_i) * _b.getCol(_j);
+        (*_m)(_j, _i) = _a.getRow(_i) * _b.getCol(_j);
     }
 
   private:
@@ -133,18 +264,18 @@ class CalcIndex
 
 inline Matrix sequencial(const Matrix &a, const Matrix &b)
 {
-    if (a.getColSize() != b.getRowSize() || a.getRowSize() != b.getColSize())
+    if (a.getColSize() != b.getRowSize())
     {
         throw("cannot multiply matrices with incompatible sizes");
     }
 
-    Matrix m(a.getRowSize(), b.getColSize());
+    Matrix m(b.getColSize(), a.getRowSize(), a.getLayout());
 
     for (int i = 0; i < a.getRowSize(); i++)
     {
         for (int j = 0; j < b.getColSize(); j++)
         {
-            m(i, j) = a.getRow(i) * b.getCol(j);
+            m(j, i) = a.getRow(i) * b.getCol(j);
         }
     }
 
@@ -153,28 +284,14 @@ inline Matrix sequencial(const Matrix &a, const Matrix &b)
 
 inline Matrix parallel(const Matrix &a, const Matrix &b)
 {
-    if (a.getColSize() != b.getRowSize() || a.getRowSize() != b.getColSize())
+    if (a.getColSize() != b.getRowSize())
     {
         throw("cannot multiply matrices with incompatible sizes");
     }
 
-    Matrix m(a.getRowSize(), b.getColSize());
-
-    std::vector<std::thread> threads;
+    Matrix m(b.getColSize(), a.getRowSize(), a.getLayout());
 
-    for (int i = 0; i < a.getRowSize(); i++)
-    {
-        for (int j = 0; j < b.getColSize(); j++)
-        {
-            CalcIndex calc(&m, a, b, i, j);
-            threads.push_back(std::thread(calc));
-        }
-    }
-
-    for (auto &thread : threads)
-    {
-        thread.join();
-    }
+    gemm::multiply(a.operand(), b.operand(), m.operand(), a.getRowSize(), b.getColSize(), a.getColSize());
 
     return m;
 }
@@ -0,0 +1,150 @@
+#ifndef METRICS
+#define METRICS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Build with METRICS_ENABLED=0 (cmake -DMETRICS=OFF) to compile the instrumentation out.
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+
+namespace metrics
+{
+
+constexpr bool enabled = METRICS_ENABLED;
+
+// Log-linear histogram in the HDR style: values below 2^subBits get a bucket each, every power
+// of two above is split into 2^subBits buckets, so any value is off by at most 1 / 2^subBits
+// (about 3%). Recording is one relaxed atomic add, plus a compare-and-swap when the max grows;
+// the count and mean are worked out from the buckets when read.
+class Histogram
+{
+  public:
+    static constexpr unsigned subBits = 5;
+    static constexpr size_t subCount = size_t(1) << subBits;
+    static constexpr size_t bucketCount = (64 - subBits + 1) * subCount;
+
+    void record(uint64_t value)
+    {
+        _counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t count() const
+    {
+        uint64_t count = 0;
+        for (const std::atomic<uint64_t> &bucket : _counts)
+        {
+            count += bucket.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    uint64_t max() const
+    {
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    // Taking each value as the middle of its bucket: off by as much as a bucket is wide.
+    double mean() const
+    {
+        uint64_t count = 0;
+        double sum = 0.0;
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            uint64_t n = _counts[i].load(std::memory_order_relaxed);
+            count += n;
+            sum += n * (static_cast<double>(lowestOf(i)) + static_cast<double>(highestOf(i))) / 2;
+        }
+        return count == 0 ? 0.0 : sum / count;
+    }
+
+    // Highest value of the bucket holding the p-th fraction of the samples, never above max().
+    // Approximate while others are recording.
+    uint64_t percentile(double p) const
+    {
+        uint64_t count = this->count();
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * count)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            seen += _counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(highestOf(i), max());
+        }
+        return max();
+    }
+
+    // Not safe against concurrent record().
+    void reset()
+    {
+        for (std::atomic<uint64_t> &count : _counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    // Below subCount the bucket is the value. Above, with m the highest set bit, the top
+    // subBits + 1 bits pick the bucket: (m - subBits) * subCount + (value >> (m - subBits)).
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < subCount)
+            return static_cast<size_t>(value);
+
+        unsigned shift = 63 - __builtin_clzll(value) - subBits;
+        return shift * subCount + static_cast<size_t>(value >> shift);
+    }
+
+    static uint64_t lowestOf(size_t bucket)
+    {
+        if (bucket < 2 * subCount)
+            return bucket;
+
+        unsigned shift = static_cast<unsigned>(bucket / subCount) - 1;
+        return static_cast<uint64_t>(bucket % subCount + subCount) << shift;
+    }
+
+    static uint64_t highestOf(size_t bucket)
+    {
+        if (bucket < 2 * subCount)
+            return bucket;
+
+        unsigned shift = static_cast<unsigned>(bucket / subCount) - 1;
+        return lowestOf(bucket) + ((uint64_t(1) << shift) - 1);
+    }
+
+    std::array<std::atomic<uint64_t>, bucketCount> _counts{};
+    std::atomic<uint64_t> _max{0};
+};
+
+// Marks carried along by whatever goes through the stages being timed, in nanoseconds. Empty
+// when metrics are compiled out.
+template <size_t N> struct Marks
+{
+    int64_t at[N]{};
+};
+
+struct NoMarks
+{
+};
+
+template <size_t N> using Timeline = std::conditional_t<enabled, Marks<N>, NoMarks>;
+
+} // namespace metrics
+
+#endif
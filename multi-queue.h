@@ -0,0 +1,139 @@
+#ifndef MULTI_QUEUE
+#define MULTI_QUEUE
+
+#include "ring-buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace multi_queue
+{
+
+// Relaxed concurrent priority queue (a MultiQueue): one small heap per shard, each behind its
+// own lock, with the key of its top published in an atomic. A push locks the shard it is given,
+// a consumer reads the tops without locking and only locks the shard it takes from, so two
+// consumers contend only when they go for the same shard. The order across shards is
+// approximate while others push and pop; within a shard it is exact.
+template <typename T> class MultiQueue
+{
+  public:
+    static constexpr uint64_t none = UINT64_MAX;
+
+    MultiQueue(size_t shards, size_t reserve = 0);
+
+    MultiQueue(const MultiQueue &) = delete;
+    MultiQueue &operator=(const MultiQueue &) = delete;
+
+    // Smallest key first, equal keys in push order. tryPop() hands back the key too when asked,
+    // so an entry can be moved to another shard as it was.
+    void push(size_t shard, uint64_t key, T value);
+    bool tryPop(size_t shard, T &value, uint64_t *key = nullptr);
+
+    // Key of the shard's top, none when it is empty. Approximate, like the sizes.
+    uint64_t top(size_t shard) const
+    {
+        return _shards[shard].top.load(std::memory_order_acquire);
+    }
+
+    size_t size(size_t shard) const
+    {
+        return _shards[shard].size.load(std::memory_order_seq_cst);
+    }
+
+    size_t size() const;
+
+    size_t shardCount() const
+    {
+        return _count;
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t key;
+        uint64_t seq;
+        T value;
+    };
+
+    // std heaps keep the largest on top: "later" entries sort first.
+    static bool later(const Entry &a, const Entry &b)
+    {
+        return a.key != b.key ? a.key > b.key : a.seq > b.seq;
+    }
+
+    struct alignas(ring_buffer::cacheLine) Shard
+    {
+        std::mutex mtx;
+        std::vector<Entry> heap;
+        std::atomic<uint64_t> top{none};
+        std::atomic<size_t> size{0};
+
+        // Push order within the shard, under mtx: later() only compares entries of one heap.
+        uint64_t seq{0};
+    };
+
+    size_t _count;
+    std::unique_ptr<Shard[]> _shards;
+};
+
+template <typename T>
+MultiQueue<T>::MultiQueue(size_t shards, size_t reserve)
+    : _count{std::max<size_t>(shards, 1)}, _shards{new Shard[_count]}
+{
+    for (size_t i = 0; i < _count; i++)
+    {
+        _shards[i].heap.reserve(reserve);
+    }
+}
+
+template <typename T> void MultiQueue<T>::push(size_t shard, uint64_t key, T value)
+{
+    Shard &s = _shards[shard];
+    std::lock_guard<std::mutex> lock(s.mtx);
+    s.heap.push_back({key, s.seq++, std::move(value)});
+    std::push_heap(s.heap.begin(), s.heap.end(), later);
+    s.top.store(s.heap.front().key, std::memory_order_release);
+    s.size.fetch_add(1, std::memory_order_seq_cst);
+}
+
+template <typename T> bool MultiQueue<T>::tryPop(size_t shard, T &value, uint64_t *key)
+{
+    Shard &s = _shards[shard];
+    if (s.size.load(std::memory_order_seq_cst) == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s.mtx);
+    if (s.heap.empty())
+        return false;
+
+    std::pop_heap(s.heap.begin(), s.heap.end(), later);
+    if (key)
+    {
+        *key = s.heap.back().key;
+    }
+    value = std::move(s.heap.back().value);
+    s.heap.pop_back();
+    s.top.store(s.heap.empty() ? none : s.heap.front().key, std::memory_order_release);
+    s.size.fetch_sub(1, std::memory_order_seq_cst);
+    return true;
+}
+
+template <typename T> size_t MultiQueue<T>::size() const
+{
+    size_t size = 0;
+    for (size_t i = 0; i < _count; i++)
+    {
+        size += this->size(i);
+    }
+    return size;
+}
+
+} // namespace multi_queue
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef POOL
+#define POOL
+
+#include "ring-buffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace pool
+{
+
+// 32-bit name of an object in a Pool.
+using Handle = uint32_t;
+
+constexpr Handle invalid = UINT32_MAX;
+
+// Fixed-capacity slab. Objects live side by side in one array and are named by their index,
+// free slots go round through a lock-free RingBuffer: acquiring or releasing one never touches
+// the allocator, and handing a handle around never touches a reference count.
+template <typename T> class Pool
+{
+  public:
+    explicit Pool(uint32_t capacity);
+    ~Pool();
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    // Builds a T in a free slot; invalid when every slot is taken.
+    template <typename... Args> Handle acquire(Args &&...args);
+
+    // Destroys the object and frees its slot. The handle must not be used afterwards.
+    void release(Handle handle);
+
+    T &operator[](Handle handle)
+    {
+        return *_slots[handle].get();
+    }
+
+    const T &operator[](Handle handle) const
+    {
+        return *_slots[handle].get();
+    }
+
+    bool live(Handle handle) const
+    {
+        return _slots[handle].live;
+    }
+
+    uint32_t capacity() const
+    {
+        return _capacity;
+    }
+
+    // Approximate while others acquire or release.
+    size_t size() const
+    {
+        return _capacity - _free.size();
+    }
+
+  private:
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+        bool live{false};
+
+        T *get()
+        {
+            return std::launder(reinterpret_cast<T *>(storage));
+        }
+    };
+
+    uint32_t _capacity;
+    std::unique_ptr<Slot[]> _slots;
+    ring_buffer::RingBuffer<Handle> _free;
+};
+
+template <typename T>
+Pool<T>::Pool(uint32_t capacity) : _capacity{capacity}, _slots{new Slot[capacity]}, _free{std::max<uint32_t>(capacity, 1)}
+{
+    for (Handle handle = 0; handle < capacity; handle++)
+    {
+        _free.tryPush(handle);
+    }
+}
+
+template <typename T> Pool<T>::~Pool()
+{
+    for (uint32_t i = 0; i < _capacity; i++)
+    {
+        if (_slots[i].live)
+        {
+            _slots[i].get()->~T();
+        }
+    }
+}
+
+template <typename T> template <typename... Args> Handle Pool<T>::acquire(Args &&...args)
+{
+    Handle handle;
+    if (!_free.tryPop(handle))
+        return invalid;
+
+    Slot &slot = _slots[handle];
+    try
+    {
+        new (slot.storage) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        // nothing was built, so the slot goes straight back
+        _free.tryPush(handle);
+        throw;
+    }
+    slot.live = true;
+    return handle;
+}
+
+template <typename T> void Pool<T>::release(Handle handle)
+{
+    Slot &slot = _slots[handle];
+    slot.get()->~T();
+    slot.live = false;
+
+    _free.tryPush(handle);
+}
+
+} // namespace pool
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef REDUCE
+#define REDUCE
+
+#include "simd-sum.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace sum_of_table
+{
+
+// Associative operations: the reduction is free to regroup them across slices.
+template <typename T> struct Plus
+{
+    static constexpr T identity()
+    {
+        return T{};
+    }
+    T operator()(const T &a, const T &b) const
+    {
+        return a + b;
+    }
+};
+
+template <typename T> struct Min
+{
+    static constexpr T identity()
+    {
+        return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                    : std::numeric_limits<T>::max();
+    }
+    T operator()(const T &a, const T &b) const
+    {
+        return b < a ? b : a;
+    }
+};
+
+template <typename T> struct Max
+{
+    static constexpr T identity()
+    {
+        return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                    : std::numeric_limits<T>::lowest();
+    }
+    T operator()(const T &a, const T &b) const
+    {
+        return a < b ? b : a;
+    }
+};
+
+template <typename Op> struct IsAssociative : std::false_type
+{
+};
+template <typename T> struct IsAssociative<Plus<T>> : std::true_type
+{
+};
+template <typename T> struct IsAssociative<Min<T>> : std::true_type
+{
+};
+template <typename T> struct IsAssociative<Max<T>> : std::true_type
+{
+};
+
+struct Identity
+{
+    template <typename T> T &&operator()(T &&x) const
+    {
+        return std::forward<T>(x);
+    }
+};
+
+// Below this many elements a slice is not worth a pool task.
+constexpr size_t minGrain = 16384;
+
+inline size_t sliceCountFor(size_t n)
+{
+    size_t slices = (n + minGrain - 1) / minGrain;
+    return std::max<size_t>(1, std::min(slices, thread_pool::ThreadPool::getInstance().size() * 4));
+}
+
+// Calls fn(i, start, end) for sliceCount contiguous slices of [0, size) on the thread pool.
+template <typename F> void forEachSlice(size_t size, size_t sliceCount, F &&fn)
+{
+    size_t split = size / sliceCount;
+
+    auto slice = [&](size_t i) {
+        size_t start = i * split;
+        size_t end = (i == sliceCount - 1) ? size : (i + 1) * split;
+        fn(i, start, end);
+    };
+
+    if (sliceCount == 1)
+    {
+        slice(0);
+        return;
+    }
+
+    thread_pool::ThreadPool::getInstance().parallelFor(0, sliceCount, slice, 1);
+}
+
+template <typename Iterator> constexpr bool isContiguousFloat()
+{
+    return std::is_same_v<Iterator, const float *> || std::is_same_v<Iterator, float *> ||
+           std::is_same_v<Iterator, std::vector<float>::const_iterator> ||
+           std::is_same_v<Iterator, std::vector<float>::iterator>;
+}
+
+// In-order fold of one slice. Plain float sums over contiguous memory go through the SIMD
+// kernel, other associative ops use independent accumulators to break the dependency chain.
+template <typename T, typename BinaryOp, typename UnaryOp, typename Iterator>
+T foldSlice(Iterator begin, Iterator end, T init, BinaryOp op, UnaryOp transform)
+{
+    using Category = typename std::iterator_traits<Iterator>::iterator_category;
+
+    if constexpr (std::is_same_v<T, float> && std::is_same_v<BinaryOp, Plus<float>> &&
+                  std::is_same_v<UnaryOp, Identity> && isContiguousFloat<Iterator>())
+    {
+        size_t n = end - begin;
+        return n == 0 ? init : init + simd::sum(&*begin, n);
+    }
+    else if constexpr (IsAssociative<BinaryOp>::value &&
+                       std::is_base_of_v<std::random_access_iterator_tag, Category>)
+    {
+        T acc[4] = {BinaryOp::identity(), BinaryOp::identity(), BinaryOp::identity(), BinaryOp::identity()};
+
+        for (; end - begin >= 4; begin += 4)
+        {
+            acc[0] = op(acc[0], transform(begin[0]));
+            acc[1] = op(acc[1], transform(begin[1]));
+            acc[2] = op(acc[2], transform(begin[2]));
+            acc[3] = op(acc[3], transform(begin[3]));
+        }
+        for (; begin != end; ++begin)
+        {
+            acc[0] = op(acc[0], transform(*begin));
+        }
+
+        return op(init, op(op(acc[0], acc[1]), op(acc[2], acc[3])));
+    }
+    else
+    {
+        for (; begin != end; ++begin)
+        {
+            init = op(init, transform(*begin));
+        }
+        return init;
+    }
+}
+
+// Reduces [begin, end) as sliceCount slices on the pool, then folds the slice results in order.
+template <typename T, typename BinaryOp, typename UnaryOp, typename Iterator>
+T transformReduceSlices(Iterator begin, Iterator end, T init, BinaryOp op, UnaryOp transform, size_t sliceCount)
+{
+    size_t n = end - begin;
+    if (sliceCount <= 1 || n == 0)
+    {
+        return foldSlice(begin, end, init, op, transform);
+    }
+
+    std::vector<T> partials(sliceCount, BinaryOp::identity());
+
+    forEachSlice(n, sliceCount, [&](size_t i, size_t start, size_t stop) {
+        partials[i] = foldSlice(begin + start, begin + stop, BinaryOp::identity(), op, transform);
+    });
+
+    for (const T &partial : partials)
+    {
+        init = op(init, partial);
+    }
+
+    return init;
+}
+
+// init op transform(x0) op transform(x1) ... Associative ops over random-access ranges are
+// split across the pool with an automatic grain size; anything else is folded in order.
+template <typename T, typename BinaryOp, typename UnaryOp, typename Iterator>
+T transformReduce(Iterator begin, Iterator end, T init, BinaryOp op, UnaryOp transform)
+{
+    using Category = typename std::iterator_traits<Iterator>::iterator_category;
+
+    if constexpr (IsAssociative<BinaryOp>::value && std::is_base_of_v<std::random_access_iterator_tag, Category>)
+    {
+        return transformReduceSlices(begin, end, init, op, transform, sliceCountFor(end - begin));
+    }
+    else
+    {
+        return foldSlice(begin, end, init, op, transform);
+    }
+}
+
+template <typename T, typename BinaryOp, typename UnaryOp, typename Range>
+T transformReduce(const Range &range, T init, BinaryOp op, UnaryOp transform)
+{
+    return sum_of_table::transformReduce(std::begin(range), std::end(range), init, op, transform);
+}
+
+template <typename T, typename BinaryOp, typename Iterator> T reduce(Iterator begin, Iterator end, T init, BinaryOp op)
+{
+    return transformReduce(begin, end, init, op, Identity{});
+}
+
+template <typename T, typename BinaryOp, typename Range> T reduce(const Range &range, T init, BinaryOp op)
+{
+    return sum_of_table::reduce(std::begin(range), std::end(range), init, op);
+}
+
+template <typename Iterator, typename Predicate> size_t countIf(Iterator begin, Iterator end, Predicate pred)
+{
+    return transformReduce(begin, end, size_t{0}, Plus<size_t>{},
+                           [&](const auto &x) -> size_t { return pred(x) ? 1 : 0; });
+}
+
+template <typename Range, typename Predicate> size_t countIf(const Range &range, Predicate pred)
+{
+    return sum_of_table::countIf(std::begin(range), std::end(range), pred);
+}
+
+} // namespace sum_of_table
+
+#endif
@@ -1,11 +1,14 @@
 #include "restaurant.h"
+#include "thread-pool.h"
 #include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <thread>
@@ -57,202 +60,647 @@ std::ostream &operator<<(std::ostream &os, const Meal &meal)
        << ingredientToString(meal.ingredients[2]) << "]";
     return os;
 }
+
+async_log::Arg logArg(const Meal &meal)
+{
+    async_log::Arg arg{[](std::ostream &os, const async_log::Arg &a) {
+                           os << "[" << ingredientToString(Ingredient(a.bytes[0])) << ", "
+                              << ingredientToString(Ingredient(a.bytes[1])) << ", "
+                              << ingredientToString(Ingredient(a.bytes[2])) << "]";
+                       },
+                       {}};
+    for (int i = 0; i < 3; i++)
+    {
+        arg.bytes[i] = static_cast<unsigned char>(meal.ingredients[i]);
+    }
+    return arg;
+}
+const char *priorityToString(Priority priority)
+{
+    switch (priority)
+    {
+    case High:
+        return "high";
+    case Normal:
+        return "normal";
+    default:
+        return "low";
+    }
+}
 // Meal End
 
+// Metrics Begin
+const char *stageToString(Stage stage)
+{
+    switch (stage)
+    {
+    case Ordering:
+        return "ordering";
+    case ToKitchen:
+        return "to kitchen";
+    case KitchenQueue:
+        return "kitchen queue";
+    case Preparing:
+        return "preparing";
+    case ChiefQueue:
+        return "chief queue";
+    case Mixing:
+        return "mixing";
+    case Handover:
+        return "handover";
+    default:
+        return "delivery";
+    }
+}
+
+int64_t nanoseconds(coro::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+void Metrics::record(const int64_t *at, Stage stage, Priority priority)
+{
+    stages[stage].record(static_cast<uint64_t>(at[stage + 1] - at[stage]));
+    if (stage == Delivery)
+    {
+        total.record(static_cast<uint64_t>(at[stage + 1] - at[0]));
+        byPriority[priority].record(static_cast<uint64_t>(at[stage + 1] - at[0]));
+    }
+}
+
+void Metrics::reset()
+{
+    for (metrics::Histogram &stage : stages)
+    {
+        stage.reset();
+    }
+    total.reset();
+    for (metrics::Histogram &priority : byPriority)
+    {
+        priority.reset();
+    }
+    kitchenDepth.reset();
+    chiefDepth.reset();
+    busyWaiters.reset();
+    cookBusyNs = 0;
+    chiefBusyNs = 0;
+    waiterBusyNs = 0;
+}
+// Metrics End
+
 // Actor Begin
-void Actor::startThread()
+template <typename Source> void logIdleStats(const Source *source)
 {
-    auto update_func = [&]() { update(); };
+    const idle::Counters &counters = source->idleCounters;
+    log(source, "idle stats {} runs ({} immediate, {} after spinning, {} after yielding, {} after parking)",
+        counters.runs.load(), counters.immediate.load(), counters.spins.load(), counters.yields.load(),
+        counters.parks.load());
+}
 
-    thread = new std::thread(update_func);
+void Actor::start()
+{
+    task = coro::spawn(run());
 }
 
-void Actor::joinThread()
+void Actor::join()
 {
-    thread->join();
+    coro::wait(task);
 }
 // Actor End
 
 // Customer Begin
 unsigned int Customer::customerID{0};
 
-Customer::Customer()
+Customer::Customer(CustomerHandle handle) : handle{handle}
 {
     ID = customerID++;
 }
 
-void Customer::update()
+coro::Task<void> Customer::run()
 {
-    order();
+    co_await order();
 
-    std::mutex mtx;
-    std::unique_lock<std::mutex> lock(mtx);
-    _cv.wait(lock, [&] { return _isServed; });
+    std::optional<MealHandle> meal = co_await _plate.pop();
+    if (!meal)
+        co_return;
+    _meal = *meal;
 
-    eat();
+    co_await eat();
     exit();
 }
 
-void Customer::order()
+void Customer::join()
+{
+    _plate.close();
+    coro::wait(task);
+}
+
+coro::Task<void> Customer::order()
 {
     static std::vector<Ingredient> options = {Potato, Garlic, Bread,   Cucumber, Shrimp,
                                               Rice,   Ham,    Avocado, Spice,    Tomato};
     static std::random_device rd;
     static std::mt19937 g(rd());
-
-    std::shuffle(options.begin(), options.end(), g);
-    Meal meal{shared_from_this(), options[0], options[1], options[2]};
+    static std::mutex mtx;
 
     Restaurant *restaurant = Restaurant::getInstance();
 
+    const Scheduling &scheduling = restaurant->scheduling;
+
+    MealHandle handle = restaurant->acquireMeal(this->handle);
+    Meal &meal = restaurant->meal(handle);
     {
-        std::ostringstream oss;
-        oss << "waiting to order";
-        log(this, oss);
+        std::lock_guard<std::mutex> lock(mtx);
+        std::shuffle(options.begin(), options.end(), g);
+        std::copy_n(options.begin(), 3, meal.ingredients);
+
+        double draw = std::uniform_real_distribution<double>(0.0, 1.0)(g);
+        meal.priority = draw < scheduling.highShare                          ? High
+                        : draw < scheduling.highShare + scheduling.lowShare ? Low
+                                                                             : Normal;
     }
 
-    std::shared_ptr<Waiter> waiter = restaurant->callForWaiter();
+    log(this, "waiting to order");
 
-    {
-        std::ostringstream oss;
-        oss << "ordered " << meal << " from waiter " << waiter->ID;
-        log(this, oss);
-    }
+    _orderedAt = coro::now();
+    meal.deadline = nanoseconds((_orderedAt + scheduling.budget[meal.priority]).time_since_epoch());
+#if METRICS_ENABLED
+    meal.timeline.at[0] = nanoseconds(_orderedAt.time_since_epoch());
+#endif
+
+    std::shared_ptr<Waiter> waiter = co_await restaurant->callForWaiter();
+
+    restaurant->mark(handle, Ordering);
 
-    waiter->giveOrder(meal);
+    log(this, "ordered {} from waiter {}", meal, waiter->ID);
+
+    co_await waiter->takeOrder(handle);
 }
 
-void Customer::serve(const Meal &meal)
+void Customer::serve(MealHandle meal)
 {
-    std::ostringstream oss;
-    oss << "served " << meal;
-    log(this, oss);
+    Restaurant *restaurant = Restaurant::getInstance();
+
+    log(this, "served {}", restaurant->meal(meal));
 
-    _meal = meal;
-    _isServed = true;
-    _cv.notify_one();
+    restaurant->recordWait(coro::now() - _orderedAt);
+    restaurant->recordDelivery(restaurant->meal(meal));
+
+    _plate.tryPush(meal);
 }
 
-void Customer::eat()
+coro::Task<void> Customer::eat()
 {
-    std::ostringstream oss;
-    oss << "eating meal " << _meal;
-    log(this, oss);
+    log(this, "eating meal {}", Restaurant::getInstance()->meal(_meal));
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    co_await coro::sleep(std::chrono::milliseconds(100));
 }
 
 void Customer::exit()
 {
-    std::ostringstream oss;
-    oss << "leaves restaurant happily";
-    log(this, oss);
+    log(this, "leaves restaurant happily");
 
     Restaurant *restaurant = Restaurant::getInstance();
 
-    restaurant->removeCustomer(shared_from_this());
+    restaurant->releaseMeal(_meal);
+    _meal = pool::invalid;
+
+    restaurant->removeCustomer(handle);
 }
 // Customer End
 
 // Waiter Begin
-unsigned int Waiter::availableCount{0};
 unsigned int Waiter::waiterID{0};
 
 Waiter::Waiter()
 {
     ID = waiterID++;
-    state = State::FREE;
-    availableCount++;
 }
 
-void Waiter::update()
+coro::Task<void> Waiter::run()
 {
     Restaurant *restaurant = Restaurant::getInstance();
 
-    while (!restaurant->closeRestaurant)
+    while (std::optional<Job> job = co_await _jobs.pop(idleStrategy, &idleCounters))
     {
-        std::mutex mtx;
-        std::unique_lock<std::mutex> lock{mtx};
-        _cv.wait(lock, [&] {
-            return restaurant->closeRestaurant || state == State::TO_CLIENT || state == State::TO_KITCHEN;
-        });
+        coro::Clock::time_point start = coro::now();
 
-        if (restaurant->closeRestaurant)
-            return;
-
-        switch (state)
+        switch (job->state)
         {
         case TO_KITCHEN: {
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            co_await coro::sleep(std::chrono::milliseconds(200));
+            restaurant->addBusy(&Metrics::waiterBusyNs, coro::now() - start);
+
+            for (MealHandle handle = job->meals; handle != pool::invalid;)
+            {
+                Meal &meal = restaurant->meal(handle);
+                MealHandle next = std::exchange(meal.next, pool::invalid);
 
-            std::ostringstream oss;
-            oss << "added meal " << _heldMeal << " to kitchen queue";
-            log(this, oss);
+                log(this, "added meal {} to kitchen queue", meal);
 
-            std::lock_guard<std::mutex> lock(restaurant->kitchenMtx);
-            restaurant->kitchenQueue.push(_heldMeal);
-            restaurant->kitchenCv.notify_one();
+                restaurant->mark(handle, ToKitchen);
+
+                restaurant->kitchen->push(handle);
+                handle = next;
+            }
         }
         break;
         case TO_CLIENT: {
-            std::ostringstream oss;
-            oss << "bringing meal to Customer..." << _heldMeal.customer->ID;
-            log(this, oss);
+            for (MealHandle handle = job->meals; handle != pool::invalid; handle = restaurant->meal(handle).next)
+            {
+                log(this, "bringing meal to Customer...{}",
+                    restaurant->customer(restaurant->meal(handle).customer).ID);
+            }
+
+            co_await coro::sleep(std::chrono::milliseconds(200));
+            restaurant->addBusy(&Metrics::waiterBusyNs, coro::now() - start);
+
+            // the customer may be done with a meal before we get to the next one
+            for (MealHandle handle = job->meals; handle != pool::invalid;)
+            {
+                Meal &meal = restaurant->meal(handle);
+                MealHandle next = std::exchange(meal.next, pool::invalid);
+
+                restaurant->mark(handle, Delivery);
+
+                restaurant->customer(meal.customer).serve(handle);
+                handle = next;
+            }
+        }
+        break;
+        default:
+            break;
+        }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        job.reset();
+        restaurant->releaseWaiter(shared_from_this());
+    }
+}
+
+void Waiter::join()
+{
+    dismiss();
+    coro::wait(task);
+}
 
-            _heldMeal.customer->serve(_heldMeal);
+void Waiter::dismiss()
+{
+    _jobs.close();
+}
+
+coro::Task<void> Waiter::takeOrder(MealHandle meal)
+{
+    Restaurant *restaurant = Restaurant::getInstance();
+
+    log(this, "received meal order from customer {} : {}",
+        restaurant->customer(restaurant->meal(meal).customer).ID, restaurant->meal(meal));
+
+    Job job{TO_KITCHEN, meal};
+    co_await _jobs.push(job);
+}
+
+coro::Task<void> Waiter::handOver(MealHandle meals)
+{
+    Restaurant *restaurant = Restaurant::getInstance();
+
+    for (MealHandle handle = meals; handle != pool::invalid; handle = restaurant->meal(handle).next)
+    {
+        const Meal &meal = restaurant->meal(handle);
+        log(this, "received prepared meal from chef to customer{} : {}", restaurant->customer(meal.customer).ID,
+            meal);
+    }
+
+    Job job{TO_CLIENT, meals};
+    co_await _jobs.push(job);
+}
+// Waiter End
+
+// Kitchen Begin
+const char *routingToString(Routing routing)
+{
+    switch (routing)
+    {
+    case Routing::RoundRobin:
+        return "round-robin";
+    case Routing::ShortestQueue:
+        return "shortest-queue";
+    default:
+        return "affinity-first";
+    }
+}
+
+const char *policyToString(Policy policy)
+{
+    switch (policy)
+    {
+    case Policy::Fifo:
+        return "fifo";
+    case Policy::Levels:
+        return "levels";
+    default:
+        return "deadline";
+    }
+}
+
+Kitchen::Kitchen(size_t stationCount, size_t capacity, Routing routing, const Scheduling &scheduling)
+    : _orders{stationCount, capacity}, _affinities(stationCount, 0), _routing{routing}, _scheduling{scheduling},
+      _cooks{new std::atomic<size_t>[std::max<size_t>(stationCount, 1)]{}}
+{
+}
+
+void Kitchen::setAffinity(size_t station, IngredientSet affinity)
+{
+    _affinities[station] = affinity;
+}
+
+size_t Kitchen::route(const Meal &meal)
+{
+    switch (_routing)
+    {
+    case Routing::RoundRobin:
+        for (size_t attempt = 0; attempt < stationCount(); attempt++)
+        {
+            size_t station = _next.fetch_add(1, std::memory_order_relaxed) % stationCount();
+            if (routable(station))
+                return station;
         }
-        break;
+        return 0;
+    case Routing::ShortestQueue:
+        return shortest(~IngredientSet(0));
+    default:
+        return shortest(ingredientBit(meal.ingredients[0]));
+    }
+}
+
+// Among the routable stations knowing any of among, or all routable ones if none does. Ties go
+// to the first.
+size_t Kitchen::shortest(IngredientSet among) const
+{
+    bool any = false;
+    for (size_t i = 0; i < stationCount(); i++)
+    {
+        any = any || (routable(i) && (_affinities[i] & among));
+    }
+
+    size_t best = 0;
+    size_t bestSize = SIZE_MAX;
+    for (size_t i = 0; i < stationCount(); i++)
+    {
+        if (!routable(i) || (any && !(_affinities[i] & among)))
+            continue;
+
+        size_t size = _orders.size(i);
+        if (size < bestSize)
+        {
+            best = i;
+            bestSize = size;
         }
+    }
+    return best;
+}
+
+void Kitchen::staff(size_t station)
+{
+    if (_cooks[station].fetch_add(1, std::memory_order_seq_cst) == 0)
+    {
+        _staffedStations.fetch_add(1, std::memory_order_seq_cst);
+    }
+}
 
-        state = FREE;
-        availableCount++;
+// The last cook out moves the station's orders, keeping their rank; as many as it had, since
+// one arriving on the way is picked up by tryPopOrphan() anyway. With nobody left anywhere they
+// stay put for whoever is hired next.
+void Kitchen::unstaff(size_t station)
+{
+    if (_cooks[station].fetch_sub(1, std::memory_order_seq_cst) != 1)
+        return;
+    if (_staffedStations.fetch_sub(1, std::memory_order_seq_cst) == 1)
+        return;
 
-        restaurant->waiterCv.notify_one();
+    Restaurant *restaurant = Restaurant::getInstance();
+    MealHandle meal;
+    uint64_t key;
+    for (size_t left = _orders.size(station); left > 0 && _orders.tryPop(station, meal, &key); left--)
+    {
+        _orders.push(route(restaurant->meal(meal)), key, meal);
     }
+    _work.notifyAll();
 }
 
-void Waiter::makeBusy()
+size_t Kitchen::leastStaffed() const
 {
-    state = CALLED;
-    availableCount--;
+    size_t best = 0;
+    for (size_t i = 1; i < stationCount(); i++)
+    {
+        if (_cooks[i].load(std::memory_order_relaxed) < _cooks[best].load(std::memory_order_relaxed))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
 
-    if (availableCount > 0)
-        Restaurant::getInstance()->waiterCv.notify_one();
+// Fifo ranks every order the same, so each station keeps push order. Levels ranks an order
+// by when it came plus aging per level below High: a Low order outranks a fresh High one once
+// it has waited twice the aging.
+uint64_t Kitchen::rank(const Meal &meal) const
+{
+    switch (_scheduling.policy)
+    {
+    case Policy::Fifo:
+        return 0;
+    case Policy::Levels:
+        return static_cast<uint64_t>(nanoseconds(coro::now().time_since_epoch()) +
+                                     meal.priority * nanoseconds(_scheduling.aging));
+    default:
+        return static_cast<uint64_t>(meal.deadline);
+    }
 }
 
-void Waiter::joinThread()
+bool Kitchen::push(MealHandle meal)
 {
-    _cv.notify_one();
+    if (_closed)
+        return false;
+
+    const Meal &order = Restaurant::getInstance()->meal(meal);
+    _orders.push(route(order), rank(order), meal);
 
-    thread->join();
+    _work.notifyOne();
+    return true;
 }
 
-void Waiter::giveOrder(const Meal &meal)
+bool Kitchen::tryPop(size_t station, MealHandle &meal)
 {
-    _heldMeal = meal;
-    state = TO_KITCHEN;
+    if (tryPopOrphan(meal))
+        return true;
+    if (_scheduling.policy != Policy::Fifo)
+        return tryPopUrgent(station, meal);
+
+    // own station first, then the busiest other one, then any other that still has something
+    if (_orders.tryPop(station, meal))
+        return true;
+
+    size_t busiest = station;
+    size_t busiestSize = 0;
+    for (size_t i = 0; i < stationCount(); i++)
+    {
+        size_t size = _orders.size(i);
+        if (i != station && size > busiestSize)
+        {
+            busiest = i;
+            busiestSize = size;
+        }
+    }
 
-    std::ostringstream oss;
-    oss << "received meal order from customer " << meal.customer->ID << " : " << meal;
-    log(this, oss);
+    bool stolen = busiest != station && _orders.tryPop(busiest, meal);
+    for (size_t i = 0; !stolen && i < stationCount(); i++)
+    {
+        stolen = i != station && _orders.tryPop(i, meal);
+    }
 
-    _cv.notify_one();
+    if (stolen)
+    {
+        _stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+    return stolen;
 }
 
-void Waiter::handOver(const Meal &meal)
+// Own station first, then the most urgent other top, read without locking. Another cook may
+// take that one first: then look again, as many times as there are stations.
+bool Kitchen::tryPopUrgent(size_t station, MealHandle &meal)
 {
-    _heldMeal = meal;
-    state = TO_CLIENT;
+    if (_orders.tryPop(station, meal))
+        return true;
+
+    for (size_t attempt = 0; attempt < stationCount(); attempt++)
+    {
+        size_t best = station;
+        uint64_t bestRank = multi_queue::MultiQueue<MealHandle>::none;
+        for (size_t i = 0; i < stationCount(); i++)
+        {
+            uint64_t rank = _orders.top(i);
+            if (i != station && rank < bestRank)
+            {
+                best = i;
+                bestRank = rank;
+            }
+        }
 
-    std::ostringstream oss;
-    oss << "received prepared meal from chef to customer" << meal.customer->ID << " : " << meal;
-    log(this, oss);
+        if (best == station)
+            return false;
 
-    _cv.notify_one();
+        if (_orders.tryPop(best, meal))
+        {
+            _stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
 }
-// Waiter End
+
+// An order routed to a station just as its last cook left: nobody else looks there first.
+bool Kitchen::tryPopOrphan(MealHandle &meal)
+{
+    for (size_t i = 0; i < stationCount(); i++)
+    {
+        if (!routable(i) && _orders.size(i) > 0 && _orders.tryPop(i, meal))
+        {
+            _stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Kitchen::size() const
+{
+    return _orders.size();
+}
+
+void Kitchen::wake()
+{
+    _work.notifyAll();
+}
+
+void Kitchen::close()
+{
+    _closed = true;
+    _work.notifyAll();
+}
+
+coro::Task<size_t> Kitchen::Station::popBatch(std::vector<MealHandle> &out, size_t max,
+                                              const idle::Strategy &strategy, idle::Counters *counters)
+{
+    if (max == 0)
+        co_return 0;
+
+    MealHandle meal;
+    Kitchen &k = kitchen;
+    auto leaving = [this] { return leave && leave->load(); };
+    bool popped = co_await coro::waitFor(
+        k._work, [&] { return k.tryPop(index, meal); }, [&] { return !k.empty() || k._closed || leaving(); },
+        [&] { return (k._closed && k.empty()) || leaving(); }, strategy, counters);
+    if (!popped)
+        co_return 0;
+
+    out.push_back(meal);
+    co_return 1 + tryPopBatch(out, max - 1);
+}
+
+size_t Kitchen::Station::tryPopBatch(std::vector<MealHandle> &out, size_t max)
+{
+    size_t taken = 0;
+    MealHandle meal;
+    while (taken < max && kitchen.tryPop(index, meal))
+    {
+        out.push_back(meal);
+        taken++;
+    }
+    return taken;
+}
+
+coro::Task<size_t> Kitchen::Station::popBatchUntil(std::vector<MealHandle> &out, size_t max,
+                                                   coro::Clock::time_point deadline)
+{
+    Kitchen &k = kitchen;
+    auto leaving = [this] { return leave && leave->load(); };
+
+    size_t taken = 0;
+    for (;;)
+    {
+        taken += tryPopBatch(out, max - taken);
+        if (taken == max || k._closed || leaving() || coro::now() >= deadline)
+            co_return taken;
+
+        co_await k._work.waitUntil([&] { return !k.empty() || k._closed || leaving(); }, deadline);
+    }
+}
+// Kitchen End
+
+// Batching Begin
+// Takes up to batching.size meals: waits for the first one like a plain pop, then waits up to
+// maxWait for the rest, leaving as soon as the batch is full. False once the queue is closed
+// and drained.
+template <typename Queue>
+coro::Task<bool> takeBatch(Queue &queue, std::vector<MealHandle> &batch, const Batching &batching,
+                           const idle::Strategy &strategy, idle::Counters *counters)
+{
+    batch.clear();
+
+    size_t size = std::max<size_t>(batching.size, 1);
+    if (co_await queue.popBatch(batch, size, strategy, counters) == 0)
+        co_return false;
+
+    if (batch.size() < size && batching.maxWait.count() > 0)
+    {
+        coro::Clock::time_point deadline = coro::now() + batching.maxWait;
+        size_t missing = size - batch.size();
+        co_await queue.popBatchUntil(batch, missing, deadline);
+    }
+
+    co_return true;
+}
+// Batching End
 
 // Cook Begin
 unsigned int Cook::cookID{0};
@@ -262,104 +710,129 @@ Cook::Cook()
     ID = cookID++;
 }
 
-std::mutex chiefQueueMtx;
-
-void Cook::update()
+coro::Task<void> Cook::run()
 {
     Restaurant *restaurant = Restaurant::getInstance();
 
-    while (!restaurant->closeRestaurant)
+    Kitchen::Station queue = restaurant->kitchen->station(station, &_dismissed);
+    std::vector<MealHandle> batch;
+
+    // checked apart from the co_await: GCC 12 evaluates a co_await even where && short-circuits
+    while (!_dismissed)
     {
-        std::mutex mtx;
-        std::unique_lock<std::mutex> lock{mtx};
-        restaurant->kitchenCv.wait(lock,
-                                   [&] { return restaurant->closeRestaurant || restaurant->kitchenQueue.size() > 0; });
+        if (!co_await takeBatch(queue, batch, batching, idleStrategy, &idleCounters))
+            break;
 
-        if (restaurant->closeRestaurant)
-            return;
+        if (batch.size() > 1)
+        {
+            log(this, "took {} orders at once", batch.size());
+        }
 
-        Meal meal;
+        for (MealHandle meal : batch)
         {
-            std::lock_guard<std::mutex> queueLock(restaurant->kitchenMtx);
-            meal = restaurant->kitchenQueue.front();
-            restaurant->kitchenQueue.pop();
+            restaurant->mark(meal, KitchenQueue);
         }
 
-        if (restaurant->kitchenQueue.size() > 0)
-            restaurant->kitchenCv.notify_one();
+        coro::Clock::time_point start = coro::now();
+        co_await prepare(batch);
+        restaurant->addBusy(&Metrics::cookBusyNs, coro::now() - start);
 
-        prepare(meal);
+        for (MealHandle meal : batch)
+        {
+            restaurant->mark(meal, Preparing);
 
-        std::lock_guard<std::mutex> chiefQueueLock(chiefQueueMtx);
-        restaurant->getChief()->chiefQueue.push(meal);
+            co_await restaurant->getChief()->chiefQueue.push(meal);
+        }
     }
 }
 
-void Cook::prepare(const Meal &meal) const
+void Cook::dismiss()
+{
+    _dismissed = true;
+    Restaurant::getInstance()->kitchen->wake();
+}
+
+coro::Task<void> Cook::prepare(const std::vector<MealHandle> &meals) const
 {
+    Restaurant *restaurant = Restaurant::getInstance();
+    IngredientSet affinity = restaurant->kitchen->affinity(station);
+
+    // setting up once per batch, then each meal on its own: half as fast off-station
+    std::chrono::milliseconds perMeal{0};
+    for (MealHandle handle : meals)
     {
-        std::ostringstream oss;
-        oss << "preparing meal..." << meal;
-        log(this, oss);
+        const Meal &meal = restaurant->meal(handle);
+        log(this, "preparing meal...{}", meal);
+
+        bool familiar = affinity & ingredientBit(meal.ingredients[0]);
+        perMeal += std::chrono::milliseconds(familiar ? 200 : 400);
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    co_await coro::sleep(std::chrono::milliseconds(200) + perMeal);
 
+    for (MealHandle handle : meals)
     {
-        std::ostringstream oss;
-        oss << "meal " << meal << " prepared!";
-        log(this, oss);
+        log(this, "meal {} prepared!", restaurant->meal(handle));
     }
 }
 // Cook End
 
 // Chief Begin
-void Chief::update()
+Chief::Chief(size_t capacity) : chiefQueue{capacity}
+{
+}
+
+coro::Task<void> Chief::run()
 {
     Restaurant *restaurant = Restaurant::getInstance();
 
-    while (!restaurant->closeRestaurant)
+    std::vector<MealHandle> batch;
+    while (co_await takeBatch(chiefQueue, batch, batching, idleStrategy, &idleCounters))
     {
-        while (chiefQueue.size() == 0)
+        for (MealHandle meal : batch)
         {
-            if (restaurant->closeRestaurant)
-                return;
-        };
+            restaurant->mark(meal, ChiefQueue);
+        }
 
-        Meal meal;
+        coro::Clock::time_point start = coro::now();
+        co_await mix(batch);
+        restaurant->addBusy(&Metrics::chiefBusyNs, coro::now() - start);
 
+        for (MealHandle meal : batch)
         {
-            std::lock_guard<std::mutex> chiefQueueLock(chiefQueueMtx);
-            meal = chiefQueue.front();
-            chiefQueue.pop();
+            restaurant->mark(meal, Mixing);
         }
 
-        mix(meal);
+        std::shared_ptr<Waiter> waiter = co_await restaurant->callForWaiter(idleStrategy);
 
-        std::shared_ptr<Waiter> waiter = restaurant->callForWaiter(); // FIX: nullptr return at times
+        // the batch travels as one, linked through the meals themselves
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            restaurant->mark(batch[i], Handover);
+            restaurant->meal(batch[i]).next = i + 1 < batch.size() ? batch[i + 1] : pool::invalid;
 
-        std::ostringstream oss;
-        oss << "handed over meal " << meal << " to Waiter " << waiter->ID;
-        log(this, oss);
+            log(this, "handed over meal {} to Waiter {}", restaurant->meal(batch[i]), waiter->ID);
+        }
 
-        waiter->handOver(meal);
+        co_await waiter->handOver(batch.front());
     }
 }
 
-void Chief::mix(const Meal &meal)
+coro::Task<void> Chief::mix(const std::vector<MealHandle> &meals)
 {
+    Restaurant *restaurant = Restaurant::getInstance();
+
+    for (MealHandle meal : meals)
     {
-        std::ostringstream oss;
-        oss << meal << " mixing...";
-        log(this, oss);
+        log(this, "{} mixing...", restaurant->meal(meal));
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // half of it setting up, once per batch
+    co_await coro::sleep(std::chrono::milliseconds(50 + 50 * static_cast<int64_t>(meals.size())));
 
+    for (MealHandle meal : meals)
     {
-        std::ostringstream oss;
-        oss << meal << " mixed!";
-        log(this, oss);
+        log(this, "{} mixed!", restaurant->meal(meal));
     }
 }
 // Chief End
@@ -371,202 +844,698 @@ Restaurant::Restaurant()
 {
 }
 
-void Restaurant::initialize()
+void Restaurant::initialize(unsigned int customerCount, unsigned int waiterCount, unsigned int cookCount)
 {
-    for (int i = 0; i < 10; i++)
+    closeRestaurant = false;
+    _mealsServed = 0;
+    _waitNs = 0;
+    for (int i = 0; i < priorityCount; i++)
     {
-        addCustomer(std::make_shared<Customer>());
+        _servedBy[i] = 0;
+        _lateBy[i] = 0;
     }
-    for (int i = 0; i < 4; i++)
+    metrics.reset();
+
+    if (virtualTime)
     {
-        addCook(std::make_shared<Cook>());
+        _simulation = std::make_unique<coro::Simulation>();
+        _simulation->install();
     }
-    for (int i = 0; i < 3; i++)
+    _openedAt = coro::now();
+    _paidUntil = _openedAt;
+    _waiterTime = {};
+    _cookTime = {};
+
+    // fixed before anyone runs, so the actors read it without a lock
+    bool open = arrivals.process != load::Process::Closed;
+    _measuredFrom = open ? _openedAt + arrivals.warmup : _openedAt;
+    size_t seated = std::max<size_t>(customerCount, open ? seats : 0);
+    size_t capacity = std::max<size_t>(queueCapacity, seated);
+    size_t maxWaiters = std::max<size_t>(waiterCount, staffing.autoscale ? staffing.maxWaiters : 0);
+    _freeWaiters = std::make_unique<coro::Channel<std::shared_ptr<Waiter>>>(std::max<size_t>(maxWaiters, 1));
+
+    // a customer holds at most one meal, so the arena never needs more slots than seats
+    _customerSlab = std::make_unique<pool::Pool<Customer>>(seated);
+    _meals = std::make_unique<pool::Pool<Meal>>(seated);
+    _present = 0;
+    _leaving.clear();
+    _loadReport = {};
+    _cookWaits = {};
+    _chiefWaits = {};
+    _servedBefore = 0;
+
+    std::vector<CustomerHandle> customers;
+    for (unsigned int i = 0; i < customerCount; i++)
     {
-        addWaiter(std::make_shared<Waiter>());
+        customers.push_back(addCustomer());
     }
-    setChief(std::make_shared<Chief>());
 
-    for (std::shared_ptr<Customer> customer : _customers)
+    // one station per cook hired now, the ingredients dealt out between them; later hires
+    // join the station with the fewest cooks
+    kitchen = std::make_unique<Kitchen>(std::max<size_t>(cookCount, 1), capacity, routing, scheduling);
+    for (int i = 0; i <= Tomato; i++)
     {
-        customer->startThread();
+        size_t station = i % kitchen->stationCount();
+        kitchen->setAffinity(station, kitchen->affinity(station) | ingredientBit(Ingredient(i)));
     }
+    setChief(std::make_shared<Chief>(capacity));
 
-    for (std::shared_ptr<Cook> cook : _cooks)
+    for (unsigned int i = 0; i < cookCount; i++)
     {
-        cook->startThread();
+        addCook(std::make_shared<Cook>());
+    }
+    for (unsigned int i = 0; i < waiterCount; i++)
+    {
+        addWaiter(std::make_shared<Waiter>());
     }
 
-    for (std::shared_ptr<Waiter> waiter : _waiters)
+    _chief->idleStrategy = chiefIdle;
+    _chief->batching = chiefBatch;
+    _chief->start();
+
+    for (CustomerHandle handle : customers)
     {
-        waiter->startThread();
+        customer(handle).start();
     }
 
-    _chief->startThread();
+#if METRICS_ENABLED
+    _sampler = coro::spawn(sample());
+#endif
+    if (staffing.autoscale)
+    {
+        _autoscaler = coro::spawn(autoscale());
+    }
+    if (open)
+    {
+        _arriving = true;
+        _arrivalTask = coro::spawn(arrive());
+    }
 }
 
 void Restaurant::close()
 {
-    while (kitchenQueue.size() > 0 || _chief->chiefQueue.size() > 0 || Waiter::availableCount < _waiters.size() ||
-           hasCustomers())
+    auto quiet = [&] {
+        return kitchen->empty() && _chief->chiefQueue.empty() && _freeWaiters->size() == _waiters.size() &&
+               _present == 0 && !_arriving;
+    };
+
+    if (_simulation)
     {
+        _simulation->runUntil([&] {
+            std::lock_guard<std::mutex> lock(_stateMtx);
+            return quiet();
+        });
     }
-
+    else
     {
-        std::ostringstream oss;
-        oss << "closing...";
-        log(this, oss);
+        std::unique_lock<std::mutex> lock(_stateMtx);
+        _stateCv.wait(lock, quiet);
     }
 
+    _serviceTime = coro::now() - _openedAt;
+
+    log(this, "closing...");
+
     closeRestaurant = true;
 
-    kitchenCv.notify_all();
-    waiterCv.notify_all();
+    if (_arrivalTask.valid())
+    {
+        coro::wait(_arrivalTask);
+        _arrivalTask = {};
 
-    for (auto customer : _customers)
+        log(this, "offered {} customers/s, achieved {} meals/s over {} ms of {} arrivals, {} turned away",
+            _loadReport.offeredRate(), _loadReport.achievedRate(),
+            std::chrono::duration<double, std::milli>(_loadReport.window).count(),
+            load::processToString(arrivals.process), _loadReport.turnedAway);
+    }
+
+    // staff is paid until the restaurant went quiet, whatever the autoscaler did since
+    if (_autoscaler.valid())
+    {
+        coro::wait(_autoscaler);
+        _autoscaler = {};
+    }
     {
-        customer->joinThread();
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        payStaff(_openedAt + _serviceTime);
     }
-    _customers.clear();
 
+#if METRICS_ENABLED
+    logMetrics();
+#endif
+
+    kitchen->close();
+    _chief->chiefQueue.close();
+    _freeWaiters->close();
+
+    if (_sampler.valid())
     {
-        std::ostringstream oss;
-        oss << "customers are gone";
-        log(this, oss);
+        coro::wait(_sampler);
+        _sampler = {};
     }
 
-    for (auto cook : _cooks)
+    for (CustomerHandle handle = 0; handle < _customerSlab->capacity(); handle++)
     {
-        cook->joinThread();
+        if (_customerSlab->live(handle))
+        {
+            customer(handle).join();
+        }
     }
-    _cooks.clear();
+    _leaving.clear();
+    _customerSlab.reset();
 
+    log(this, "customers are gone");
+
+    log(this, "paid {} ms of cooks and {} ms of waiters, {} cooks and {} waiters at the end",
+        std::chrono::duration<double, std::milli>(_cookTime).count(),
+        std::chrono::duration<double, std::milli>(_waiterTime).count(), _cooks.size(), _waiters.size());
+
+    for (auto cook : _cooks)
     {
-        std::ostringstream oss;
-        oss << "cooks have left";
-        log(this, oss);
+        cook->join();
+        logIdleStats(cook.get());
+        _cookWaits.add(cook->idleCounters);
     }
+    _cooks.clear();
+
+    log(this, "cooks have left, {} orders stolen between stations ({} routing, {} scheduling)", kitchen->stolen(),
+        routingToString(routing), policyToString(scheduling.policy));
 
     for (auto waiter : _waiters)
     {
-        waiter->joinThread();
+        waiter->join();
+        logIdleStats(waiter.get());
     }
     _waiters.clear();
+    _freeWaiters.reset();
+
+    log(this, "waiters are gone");
 
+    for (auto actor : _dismissed)
     {
-        std::ostringstream oss;
-        oss << "waiters are gone";
-        log(this, oss);
+        actor->join();
+        if (dynamic_cast<Cook *>(actor.get()))
+        {
+            _cookWaits.add(actor->idleCounters);
+        }
     }
+    _dismissed.clear();
+
+    _chief->join();
+    logIdleStats(_chief.get());
+    _chiefWaits.add(_chief->idleCounters);
+    _meals.reset();
 
-    _chief->joinThread();
+    log(this, "late: {} of {} high, {} of {} normal, {} of {} low priority meals", late(High), served(High),
+        late(Normal), served(Normal), late(Low), served(Low));
+
+    log(this, "served {} meals in {} ms of {} time, {} ms mean wait", _mealsServed,
+        std::chrono::duration<double, std::milli>(_serviceTime).count(), _simulation ? "virtual" : "real",
+        std::chrono::duration<double, std::milli>(meanWait()).count());
+
+    if (_simulation)
+    {
+        log(this, "simulation ran {} events", _simulation->events());
+        _simulation.reset();
+    }
+
+    async_log::Logger::getInstance().flush();
 }
 
 Restaurant::~Restaurant()
 {
 }
 
-std::shared_ptr<Waiter> Restaurant::callForWaiter()
+coro::Task<std::shared_ptr<Waiter>> Restaurant::callForWaiter(const idle::Strategy &strategy)
 {
-    static std::mutex mtx;
+    _calling.fetch_add(1, std::memory_order_relaxed);
+    std::optional<std::shared_ptr<Waiter>> waiter = co_await _freeWaiters->pop(strategy);
+    _calling.fetch_sub(1, std::memory_order_relaxed);
+    if (!waiter)
+    {
+        throw("no waiter left, the restaurant is closed");
+    }
 
-    std::unique_lock<std::mutex> lock(mtx);
-    waiterCv.wait(lock, [&] { return (Waiter::availableCount > 0); });
+    co_return std::move(*waiter);
+}
 
-    for (std::shared_ptr<Waiter> waiter : _waiters)
+void Restaurant::releaseWaiter(std::shared_ptr<Waiter> waiter)
+{
+    _freeWaiters->tryPush(std::move(waiter));
+
+    notifyProgress();
+}
+
+CustomerHandle Restaurant::addCustomer()
+{
+    CustomerHandle handle = _customerSlab->acquire(pool::invalid);
+    if (handle == pool::invalid)
     {
-        if (waiter->isAvailable())
+        throw("no seat left, the restaurant is full");
+    }
+    customer(handle).handle = handle;
+
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        count = ++_present;
+    }
+
+    log(this, "{} customers now.", count);
+
+    return handle;
+}
+
+void Restaurant::removeCustomer(CustomerHandle handle)
+{
+    size_t remaining;
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        _leaving.push_back(handle);
+        _mealsServed++;
+        remaining = --_present;
+    }
+
+    log(this, "{} customers now.", remaining);
+
+    notifyProgress();
+}
+
+// Only called by arrive(), the one seating customers while serving: nobody else frees a seat.
+void Restaurant::reapCustomers()
+{
+    std::vector<CustomerHandle> leaving;
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        leaving.swap(_leaving);
+    }
+
+    std::vector<CustomerHandle> lingering;
+    for (CustomerHandle handle : leaving)
+    {
+        if (customer(handle).task.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            _customerSlab->release(handle);
+        else
+            lingering.push_back(handle);
+    }
+
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    _leaving.insert(_leaving.end(), lingering.begin(), lingering.end());
+}
+
+coro::Task<void> Restaurant::arrive()
+{
+    load::Arrivals next(arrivals);
+    coro::Clock::time_point start = _openedAt;
+    bool measuring = false;
+
+    load::Duration at;
+    size_t count;
+    while (next.next(at, count))
+    {
+        if (!measuring && at >= arrivals.warmup)
+        {
+            co_await coro::sleepUntil(start + arrivals.warmup);
+            startMeasuring();
+            measuring = true;
+        }
+
+        co_await coro::sleepUntil(start + at);
+        reapCustomers();
+
+        for (size_t i = 0; i < count; i++)
         {
-            waiter->makeBusy();
-            return waiter;
+            bool full = _customerSlab->size() >= _customerSlab->capacity();
+            if (measuring)
+            {
+                _loadReport.offered++;
+                _loadReport.turnedAway += full;
+            }
+            if (!full)
+            {
+                customer(addCustomer()).start();
+            }
         }
     }
 
-    return nullptr;
+    if (!measuring)
+    {
+        co_await coro::sleepUntil(start + arrivals.warmup);
+        startMeasuring();
+    }
+    co_await coro::sleepUntil(start + arrivals.end());
+
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        _loadReport.served = _mealsServed - _servedBefore;
+        _loadReport.window = arrivals.duration;
+        _arriving = false;
+    }
+    notifyProgress();
 }
 
-void Restaurant::addCustomer(std::shared_ptr<Customer> customer)
+// At _measuredFrom. The metrics need no reset: they already leave out whatever came before.
+void Restaurant::startMeasuring()
 {
-    _customers.push_back(customer);
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    payStaff(coro::now());
+    _waiterTime = {};
+    _cookTime = {};
+    _servedBefore = _mealsServed;
+}
 
-    std::ostringstream oss;
-    oss << std::to_string(_customers.size()) << " customers now.";
-    log(this, oss);
+MealHandle Restaurant::acquireMeal(CustomerHandle customer)
+{
+    MealHandle handle = _meals->acquire();
+    if (handle == pool::invalid)
+    {
+        throw("no meal slot left in the arena");
+    }
+    meal(handle).customer = customer;
+
+    return handle;
 }
 
-void Restaurant::removeCustomer(std::shared_ptr<Customer> customer)
+void Restaurant::releaseMeal(MealHandle handle)
 {
-    auto it = std::find(_customers.begin(), _customers.end(), customer);
+    _meals->release(handle);
+}
+
+void Restaurant::recordWait(coro::Clock::duration wait)
+{
+    _waitNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count(),
+                      std::memory_order_relaxed);
+}
 
-    if (it != _customers.end())
+void Restaurant::recordDelivery(const Meal &meal)
+{
+    _servedBy[meal.priority].fetch_add(1, std::memory_order_relaxed);
+    if (nanoseconds(coro::now().time_since_epoch()) > meal.deadline)
     {
-        _customers.erase(it);
+        _lateBy[meal.priority].fetch_add(1, std::memory_order_relaxed);
     }
+}
+
+coro::Clock::duration Restaurant::meanWait() const
+{
+    if (_mealsServed == 0)
+        return {};
 
-    std::ostringstream oss;
-    oss << std::to_string(_customers.size()) << " customers now.";
-    log(this, oss);
+    return std::chrono::duration_cast<coro::Clock::duration>(
+        std::chrono::nanoseconds(_waitNs.load(std::memory_order_relaxed) / static_cast<int64_t>(_mealsServed)));
 }
 
-void Restaurant::addWaiter(std::shared_ptr<Waiter> waiter)
+void Restaurant::mark(MealHandle handle, Stage stage)
 {
-    _waiters.push_back(waiter);
+#if METRICS_ENABLED
+    int64_t now = nanoseconds(coro::now().time_since_epoch());
+    int64_t *at = meal(handle).timeline.at;
+
+    at[stage + 1] = now;
+    if (at[0] < nanoseconds(_measuredFrom.time_since_epoch()))
+        return;
+
+    metrics.record(at, stage, meal(handle).priority);
+#else
+    (void)handle;
+    (void)stage;
+#endif
 }
 
-void Restaurant::removeWaiter(std::shared_ptr<Waiter> waiter)
+void Restaurant::addBusy(std::atomic<int64_t> Metrics::*role, coro::Clock::duration busy)
 {
-    auto it = std::find(_waiters.begin(), _waiters.end(), waiter);
+#if METRICS_ENABLED
+    coro::Clock::time_point now = coro::now();
+    busy = std::min(busy, now - std::min(now, _measuredFrom));
+    if (busy.count() <= 0)
+        return;
+
+    (metrics.*role).fetch_add(nanoseconds(busy), std::memory_order_relaxed);
+#else
+    (void)role;
+    (void)busy;
+#endif
+}
 
-    if (it != _waiters.end())
+coro::Task<void> Restaurant::sample()
+{
+    std::chrono::milliseconds interval = std::max(sampleInterval, std::chrono::milliseconds(1));
+    coro::Clock::time_point nextDump = coro::now() + metricsDump;
+
+    co_await coro::sleepUntil(_measuredFrom);
+    while (!closeRestaurant)
     {
-        _waiters.erase(it);
+        metrics.kitchenDepth.record(kitchen->size());
+        metrics.chiefDepth.record(_chief->chiefQueue.size());
+        size_t waiters = waiterCount();
+        metrics.busyWaiters.record(waiters - std::min(waiters, _freeWaiters->size()));
+
+        if (metricsDump.count() > 0 && coro::now() >= nextDump)
+        {
+            logMetrics();
+            nextDump += metricsDump;
+        }
+
+        co_await coro::sleep(interval);
     }
 }
 
-void Restaurant::addCook(std::shared_ptr<Cook> cook)
+void Restaurant::logMetrics()
 {
-    _cooks.push_back(cook);
+    auto ms = [](uint64_t ns) { return static_cast<double>(ns) / 1e6; };
+
+    for (int i = 0; i < stageCount; i++)
+    {
+        const metrics::Histogram &stage = metrics.stages[i];
+        log(this, "{}: p50 {} ms, p99 {} ms, p999 {} ms, max {} ms", stageToString(Stage(i)),
+            ms(stage.percentile(0.5)), ms(stage.percentile(0.99)), ms(stage.percentile(0.999)), ms(stage.max()));
+    }
+    log(this, "total: p50 {} ms, p99 {} ms, p999 {} ms, max {} ms over {} meals", ms(metrics.total.percentile(0.5)),
+        ms(metrics.total.percentile(0.99)), ms(metrics.total.percentile(0.999)), ms(metrics.total.max()),
+        metrics.total.count());
+    for (int i = 0; i < priorityCount; i++)
+    {
+        const metrics::Histogram &priority = metrics.byPriority[i];
+        if (priority.count() == 0)
+            continue;
+        log(this, "{} priority: p50 {} ms, p99 {} ms, max {} ms over {} meals", priorityToString(Priority(i)),
+            ms(priority.percentile(0.5)), ms(priority.percentile(0.99)), ms(priority.max()), priority.count());
+    }
+
+    log(this, "kitchen queue depth: p50 {}, p99 {}, max {}", metrics.kitchenDepth.percentile(0.5),
+        metrics.kitchenDepth.percentile(0.99), metrics.kitchenDepth.max());
+    log(this, "chief queue depth: p50 {}, p99 {}, max {}", metrics.chiefDepth.percentile(0.5),
+        metrics.chiefDepth.percentile(0.99), metrics.chiefDepth.max());
+    log(this, "waiters out: p50 {}, p99 {}, max {}", metrics.busyWaiters.percentile(0.5),
+        metrics.busyWaiters.percentile(0.99), metrics.busyWaiters.max());
+
+    // of the time paid for, staff coming and going
+    auto utilization = [&](const std::atomic<int64_t> &busy, coro::Clock::duration paid) {
+        double paidNs = static_cast<double>(nanoseconds(paid));
+        return paidNs <= 0 ? 0.0 : 100.0 * static_cast<double>(busy.load()) / paidNs;
+    };
+    coro::Clock::time_point until = closeRestaurant ? _openedAt + _serviceTime : coro::now();
+    log(this, "utilization: cooks {}%, chief {}%, waiters {}%", utilization(metrics.cookBusyNs, cookTime()),
+        utilization(metrics.chiefBusyNs, until - _measuredFrom), utilization(metrics.waiterBusyNs, waiterTime()));
+}
+
+void Restaurant::notifyProgress()
+{
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+    }
+    _stateCv.notify_all();
 }
 
-void Restaurant::removeCook(std::shared_ptr<Cook> cook)
+// The slot is taken before the waiter starts: one that cannot be hired never runs, and one that
+// runs is always in _waiters for close() to join.
+void Restaurant::addWaiter(std::shared_ptr<Waiter> waiter)
 {
-    auto it = std::find(_cooks.begin(), _cooks.end(), cook);
+    waiter->idleStrategy = waiterIdle;
 
-    if (it != _cooks.end())
     {
-        _cooks.erase(it);
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        if (_waiters.size() >= _freeWaiters->capacity())
+        {
+            throw("no room for another waiter");
+        }
+        payStaff(coro::now());
+        _waiters.push_back(waiter);
     }
+
+    waiter->start();
+    _freeWaiters->tryPush(waiter);
+
+    notifyProgress();
 }
 
-void Restaurant::setChief(std::shared_ptr<Chief> chief)
+std::shared_ptr<Waiter> Restaurant::removeWaiter()
 {
-    _chief = chief;
+    std::shared_ptr<Waiter> waiter;
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        if (_waiters.size() <= 1 || !_freeWaiters->tryPop(waiter))
+            return nullptr;
+
+        payStaff(coro::now());
+        _waiters.erase(std::find(_waiters.begin(), _waiters.end(), waiter));
+        _dismissed.push_back(waiter);
+    }
+    waiter->dismiss();
+
+    notifyProgress();
+    return waiter;
 }
 
-Restaurant *Restaurant::getInstance()
+void Restaurant::addCook(std::shared_ptr<Cook> cook)
 {
-    static Restaurant instance;
-    return &instance;
+    cook->idleStrategy = cookIdle;
+    cook->batching = cookBatch;
+
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        payStaff(coro::now());
+        cook->station = kitchen->leastStaffed();
+        _cooks.push_back(cook);
+    }
+    kitchen->staff(cook->station);
+
+    cook->start();
 }
 
-std::string getCurrentTime()
+// The last one hired goes first. Below the crew initialize() started with that leaves stations
+// without a cook, and the kitchen routes their ingredients and orders to the others.
+std::shared_ptr<Cook> Restaurant::removeCook()
 {
-    auto t = std::time(nullptr);
-    auto tm = *std::localtime(&t);
+    std::shared_ptr<Cook> cook;
+    {
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        if (_cooks.size() <= 1)
+            return nullptr;
+
+        payStaff(coro::now());
+        cook = _cooks.back();
+        _cooks.pop_back();
+        _dismissed.push_back(cook);
+    }
+    kitchen->unstaff(cook->station);
+    cook->dismiss();
 
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "[%H:%M:%S]");
-    return oss.str();
+    return cook;
 }
 
-void Restaurant::logThreadSafe(const std::string &str) const
+size_t Restaurant::waiterCount()
 {
-    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    return _waiters.size();
+}
 
-    std::lock_guard<std::mutex> lock(mtx);
+size_t Restaurant::cookCount()
+{
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    return _cooks.size();
+}
 
-    std::cout << getCurrentTime() << str << std::endl;
+coro::Clock::duration Restaurant::waiterTime()
+{
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    payStaff(closeRestaurant ? _paidUntil : coro::now());
+    return _waiterTime;
+}
+
+coro::Clock::duration Restaurant::cookTime()
+{
+    std::lock_guard<std::mutex> lock(_stateMtx);
+    payStaff(closeRestaurant ? _paidUntil : coro::now());
+    return _cookTime;
 }
+
+void Restaurant::payStaff(coro::Clock::time_point until)
+{
+    if (until <= _paidUntil)
+        return;
+
+    coro::Clock::duration shift = until - _paidUntil;
+    _waiterTime += shift * static_cast<int64_t>(_waiters.size());
+    _cookTime += shift * static_cast<int64_t>(_cooks.size());
+    _paidUntil = until;
+}
+
+// Checks in a row past high (+1) or low (-1); a verdict once patience is reached, then starts
+// counting again.
+int staffingVerdict(double signal, double low, double high, unsigned int patience, int &streak)
+{
+    int direction = signal > high ? 1 : signal < low ? -1 : 0;
+    streak = direction != 0 && (streak > 0) == (direction > 0) ? streak + direction : direction;
+
+    if (std::abs(streak) < static_cast<int>(std::max(patience, 1u)))
+        return 0;
+
+    streak = 0;
+    return direction;
+}
+
+coro::Task<void> Restaurant::autoscale()
+{
+    int cookStreak = 0;
+    int waiterStreak = 0;
+
+    while (!closeRestaurant)
+    {
+        co_await coro::sleep(std::max(staffing.interval, std::chrono::milliseconds(1)));
+
+        size_t cooks = std::max<size_t>(cookCount(), 1);
+        size_t waiters = std::max<size_t>(waiterCount(), 1);
+        size_t waiting = kitchen->size();
+        size_t out = waiters - std::min(waiters, _freeWaiters->size());
+        size_t calling = _calling.load(std::memory_order_relaxed);
+
+        int cookVerdict = staffingVerdict(static_cast<double>(waiting) / cooks, staffing.cookLow, staffing.cookHigh,
+                                          staffing.patience, cookStreak);
+        if (cookVerdict > 0 && cooks < staffing.maxCooks)
+        {
+            std::shared_ptr<Cook> cook = std::make_shared<Cook>();
+            addCook(cook);
+            log(this, "hired Cook {}, {} orders waiting for {} cooks", cook->ID, waiting, cooks);
+        }
+        else if (cookVerdict < 0 && cooks > staffing.minCooks)
+        {
+            if (std::shared_ptr<Cook> cook = removeCook())
+            {
+                log(this, "dismissed Cook {}, {} orders waiting for {} cooks", cook->ID, waiting, cooks);
+            }
+        }
+
+        int waiterVerdict = staffingVerdict(static_cast<double>(out + calling) / waiters, staffing.waiterLow,
+                                            staffing.waiterHigh, staffing.patience, waiterStreak);
+        if (waiterVerdict > 0 && waiters < staffing.maxWaiters)
+        {
+            std::shared_ptr<Waiter> waiter = std::make_shared<Waiter>();
+            addWaiter(waiter);
+            log(this, "hired Waiter {}, {} of {} waiters out and {} calls waiting", waiter->ID, out, waiters, calling);
+        }
+        else if (waiterVerdict < 0 && waiters > staffing.minWaiters)
+        {
+            if (std::shared_ptr<Waiter> waiter = removeWaiter())
+            {
+                log(this, "dismissed Waiter {}, {} of {} waiters out and {} calls waiting", waiter->ID, out, waiters,
+                    calling);
+            }
+        }
+    }
+}
+
+void Restaurant::setChief(std::shared_ptr<Chief> chief)
+{
+    _chief = chief;
+}
+
+Restaurant *Restaurant::getInstance()
+{
+    static Restaurant instance;
+    return &instance;
+}
+
 // Restaurant End
 
 } // namespace restaurant
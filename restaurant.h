@@ -1,12 +1,22 @@
 #ifndef RESTAURANT
 #define RESTAURANT
 
+#include "async-log.h"
+#include "coro.h"
+#include "idle.h"
+#include "load.h"
+#include "metrics.h"
+#include "multi-queue.h"
+#include "pool.h"
+
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <future>
 #include <iostream>
 #include <memory>
-#include <queue>
-#include <sstream>
-#include <string>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -27,47 +37,318 @@ enum Ingredient
     Tomato,
 };
 
+// Smallest kitchen and chief queues. Waiters block on a full kitchen while the chief needs a
+// free waiter to drain its queue, so the queues also get room for one meal per customer.
+constexpr size_t queueCapacity = 64;
+
+// What happens to a meal between the order and the table, in order. Each stage ends where the
+// next one starts.
+enum Stage
+{
+    Ordering,     // customer waits for a waiter
+    ToKitchen,    // waiter walks the order to the kitchen
+    KitchenQueue, // order waits for a cook
+    Preparing,    // cook at work
+    ChiefQueue,   // prepared meal waits for the chief
+    Mixing,       // chief at work
+    Handover,     // mixed meal waits for a waiter
+    Delivery,     // waiter walks the meal to the customer
+    stageCount,
+};
+
+const char *stageToString(Stage stage);
+
+// How urgent an order is. Each priority has its own budget from the order to the table: the
+// order's deadline.
+enum Priority
+{
+    High,
+    Normal,
+    Low,
+    priorityCount,
+};
+
+const char *priorityToString(Priority priority);
+
+// Customers sit in a slab and meals in an arena, both named by 32-bit handles: that is all the
+// queues, jobs and batches carry.
+using CustomerHandle = pool::Handle;
+using MealHandle = pool::Handle;
+
 struct Meal
 {
-    std::shared_ptr<class Customer> customer;
+    CustomerHandle customer{pool::invalid};
     Ingredient ingredients[3];
+
+    Priority priority{Normal};
+    int64_t deadline{0}; // nanoseconds, on coro::now()'s clock
+
+    // Next meal of the same batch while the batch travels as one.
+    MealHandle next{pool::invalid};
+
+    // When the meal was ordered, then when each stage ended.
+    [[no_unique_address]] metrics::Timeline<stageCount + 1> timeline{};
+};
+
+// Latency of every stage and in total, plus what the sampler sees every sampleInterval: queue
+// depths and how many waiters are out. Busy times are summed per role for utilization.
+struct Metrics
+{
+    metrics::Histogram stages[stageCount];
+    metrics::Histogram total;
+    metrics::Histogram byPriority[priorityCount];
+
+    metrics::Histogram kitchenDepth;
+    metrics::Histogram chiefDepth;
+    metrics::Histogram busyWaiters;
+
+    std::atomic<int64_t> cookBusyNs{0};
+    std::atomic<int64_t> chiefBusyNs{0};
+    std::atomic<int64_t> waiterBusyNs{0};
+
+    // Records a meal's stage ending at at[stage + 1], its timeline in nanoseconds; the total too
+    // once it is delivered.
+    void record(const int64_t *at, Stage stage, Priority priority);
+
+    void reset();
+};
+
+// How many meals a cook or the chief takes per wakeup, and how long the first one may wait
+// for the rest of the batch to show up. A batch is prepared or mixed in one go: the setup is
+// paid once, each meal still takes its own time. The default is one meal at a time.
+struct Batching
+{
+    size_t size{1};
+    std::chrono::milliseconds maxWait{0};
+};
+
+// What waiting for work cost a stage over a service: how many times it went to its queue and
+// came back with something, and how many of those it had to park first.
+struct WaitCost
+{
+    size_t pops{0};
+    size_t parks{0};
+
+    void add(const idle::Counters &counters)
+    {
+        pops += counters.runs.load(std::memory_order_relaxed);
+        parks += counters.parks.load(std::memory_order_relaxed);
+    }
+};
+
+// How an order picks its station.
+enum class Routing
+{
+    RoundRobin,    // every station in turn, whatever the order
+    ShortestQueue, // the station with the fewest waiting orders
+    AffinityFirst, // the shortest station whose cook knows the main ingredient
+};
+
+const char *routingToString(Routing routing);
+
+// Bounds and thresholds for the autoscaler, checked every interval. A cook is hired while the
+// kitchen keeps more than cookHigh orders per cook waiting and dismissed while it keeps fewer
+// than cookLow. Waiters follow their load: those out on a job plus the calls waiting for one,
+// per waiter. A signal has to stay past its mark for patience checks in a row, and the gap
+// between the marks keeps staff from flapping.
+struct Staffing
+{
+    bool autoscale{false};
+    std::chrono::milliseconds interval{100};
+    unsigned int patience{3};
+
+    size_t minCooks{1};
+    size_t maxCooks{8};
+    double cookHigh{2.0};
+    double cookLow{0.5};
+
+    size_t minWaiters{1};
+    size_t maxWaiters{8};
+    double waiterHigh{1.5};
+    double waiterLow{0.4};
+};
+
+// In which order the kitchen takes its orders.
+enum class Policy
+{
+    Fifo,     // as they came, per station
+    Levels,   // highest priority first, aged: waiting aging makes up for one level
+    Deadline, // earliest deadline first
+};
+
+const char *policyToString(Policy policy);
+
+// The kitchen's policy, and what customers order: shares of high and low priority orders (the
+// rest are normal) and each priority's budget.
+struct Scheduling
+{
+    Policy policy{Policy::Fifo};
+    std::chrono::milliseconds aging{1000};
+
+    double highShare{0.0};
+    double lowShare{0.0};
+    std::chrono::milliseconds budget[priorityCount]{std::chrono::milliseconds(2000), std::chrono::milliseconds(5000),
+                                                    std::chrono::milliseconds(15000)};
+};
+
+// Ingredients as bits, for station affinities.
+using IngredientSet = uint16_t;
+
+constexpr IngredientSet ingredientBit(Ingredient ingredient)
+{
+    return IngredientSet(1) << ingredient;
+}
+
+// One queue per cooking station, each with the ingredients its cook is good at. Orders are
+// routed on their main (first) ingredient, and each station is a shard of a MultiQueue ranked
+// by the scheduling policy. A cook whose station runs dry steals before it parks, so a skewed
+// menu still keeps every cook busy: from the busiest other station under Policy::Fifo, else
+// the most urgent order in the kitchen. Cooking off-station is slow, so a cook with orders of
+// its own never leaves them for more urgent ones elsewhere. Orders only go to stations that
+// have a cook: when the last one leaves a station, its ingredients go to the shortest staffed
+// queue and what it had queued is routed again.
+class Kitchen
+{
+  public:
+    // The cook side of one station, shaped like coro::Channel's batch calls.
+    struct Station
+    {
+        Kitchen &kitchen;
+        size_t index;
+
+        // Set when the cook is to leave: a parked popBatch gives up instead of waiting on.
+        const std::atomic<bool> *leave{nullptr};
+
+        coro::Task<size_t> popBatch(std::vector<MealHandle> &out, size_t max, const idle::Strategy &strategy,
+                                    idle::Counters *counters);
+        size_t tryPopBatch(std::vector<MealHandle> &out, size_t max);
+        coro::Task<size_t> popBatchUntil(std::vector<MealHandle> &out, size_t max, coro::Clock::time_point deadline);
+    };
+
+    Kitchen(size_t stationCount, size_t capacity, Routing routing, const Scheduling &scheduling);
+
+    void setAffinity(size_t station, IngredientSet affinity);
+    IngredientSet affinity(size_t station) const
+    {
+        return _affinities[station];
+    }
+
+    size_t route(const Meal &meal);
+
+    // A cook starts or stops working a station.
+    void staff(size_t station);
+    void unstaff(size_t station);
+
+    // The station with the fewest cooks, the first of them on a tie.
+    size_t leastStaffed() const;
+
+    // False once the kitchen is closed. Never waits: there are no more orders than meal slots,
+    // and the stations reserve room for all of them, so the bound on orders in flight is the
+    // meal pool and the chief's channel rather than the stations.
+    bool push(MealHandle meal);
+
+    Station station(size_t index, const std::atomic<bool> *leave = nullptr)
+    {
+        return {*this, index, leave};
+    }
+
+    // Wakes every idle cook, so one told to leave sees it.
+    void wake();
+    void close();
+
+    size_t size() const;
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t stationCount() const
+    {
+        return _orders.shardCount();
+    }
+
+    // Orders a cook took from a station other than its own.
+    size_t stolen() const
+    {
+        return _stolen.load(std::memory_order_relaxed);
+    }
+
+  private:
+    bool tryPop(size_t station, MealHandle &meal);
+    bool tryPopUrgent(size_t station, MealHandle &meal);
+    bool tryPopOrphan(MealHandle &meal);
+    size_t shortest(IngredientSet among) const;
+
+    // Whether orders may be routed to the station: it has a cook, or no station has one yet.
+    bool routable(size_t station) const
+    {
+        return _cooks[station].load(std::memory_order_seq_cst) > 0 ||
+               _staffedStations.load(std::memory_order_seq_cst) == 0;
+    }
+
+    // Lower ranks are taken first.
+    uint64_t rank(const Meal &meal) const;
+
+    multi_queue::MultiQueue<MealHandle> _orders;
+    std::vector<IngredientSet> _affinities{};
+    Routing _routing;
+    Scheduling _scheduling;
+
+    std::unique_ptr<std::atomic<size_t>[]> _cooks;
+    std::atomic<size_t> _staffedStations{0};
+
+    std::atomic<size_t> _next{0};
+    std::atomic<size_t> _stolen{0};
+    std::atomic<bool> _closed{false};
+
+    // Idle cooks, whatever their station: any order may be theirs to steal.
+    coro::WaitList _work;
 };
 
+// Actors are coroutines on the thread pool: waiting for a queue, a waiter or the end of a
+// sleep suspends the frame and leaves the thread to someone else.
 class Actor
 {
   public:
-    void startThread();
-    virtual void joinThread();
+    void start();
+    virtual void join();
+
+    virtual coro::Task<void> run() = 0;
 
-    virtual void update() = 0;
+    std::future<void> task{};
 
-    std::thread *thread{nullptr};
+    idle::Strategy idleStrategy{};
+    idle::Counters idleCounters{};
 };
 
-class Customer : public Actor, public std::enable_shared_from_this<Customer>
+// Lives in the restaurant's customer slab until close().
+class Customer : public Actor
 {
   public:
-    Customer();
+    explicit Customer(CustomerHandle handle);
 
-    void update() override;
+    coro::Task<void> run() override;
+    void join() override;
 
-    void order();
-    void serve(const Meal &meal);
-    void eat();
+    coro::Task<void> order();
+    void serve(MealHandle meal);
+    coro::Task<void> eat();
     void exit();
 
+    CustomerHandle handle;
     unsigned int ID;
 
   private:
-    bool _isServed = false;
-    Meal _meal;
+    MealHandle _meal{pool::invalid};
+    coro::Clock::time_point _orderedAt{};
 
-    std::condition_variable _cv;
+    // Where the waiter puts the meal down.
+    coro::Channel<MealHandle> _plate{1};
 
     static unsigned int customerID;
 };
 
-class Waiter : public Actor
+class Waiter : public Actor, public std::enable_shared_from_this<Waiter>
 {
   public:
     enum State
@@ -75,33 +356,31 @@ class Waiter : public Actor
         FREE,
         TO_KITCHEN,
         TO_CLIENT,
-        CALLED,
     };
 
     Waiter();
 
-    void update() override;
-    void joinThread() override;
-
-    void giveOrder(const Meal &meal);
-    void handOver(const Meal &meal);
+    coro::Task<void> run() override;
+    void join() override;
 
-    void bringMeal(const Meal &meal);
+    // Ends run() once the jobs in hand are done.
+    void dismiss();
 
-    bool isAvailable() const
-    {
-        return state == State::FREE;
-    }
-    void makeBusy();
+    // Only for a waiter taken from callForWaiter(): it does one job, then frees itself.
+    // Prepared meals come linked through Meal::next and are carried together, in one trip.
+    coro::Task<void> takeOrder(MealHandle meal);
+    coro::Task<void> handOver(MealHandle meals);
 
     unsigned int ID;
-    static unsigned int availableCount;
 
   private:
-    volatile State state{FREE};
-    Meal _heldMeal{};
+    struct Job
+    {
+        State state;
+        MealHandle meals;
+    };
 
-    std::condition_variable _cv;
+    coro::Channel<Job> _jobs{1};
 
     static unsigned int waiterID;
 };
@@ -111,24 +390,37 @@ class Cook : public Actor
   public:
     Cook();
 
-    void update() override;
+    coro::Task<void> run() override;
+
+    // Slower for meals whose main ingredient is not one of the station's.
+    coro::Task<void> prepare(const std::vector<MealHandle> &meals) const;
 
-    void prepare(const Meal &meal) const;
+    // Ends run() once the batch in hand has gone to the chief.
+    void dismiss();
+
+    Batching batching{};
+    size_t station{0};
 
     unsigned int ID;
 
   private:
+    std::atomic<bool> _dismissed{false};
+
     static unsigned int cookID;
 };
 
 class Chief : public Actor
 {
   public:
-    void update() override;
+    Chief(size_t capacity = queueCapacity);
 
-    void mix(const Meal &meal);
+    coro::Task<void> run() override;
 
-    std::queue<Meal> chiefQueue{};
+    coro::Task<void> mix(const std::vector<MealHandle> &meals);
+
+    Batching batching{};
+
+    coro::Channel<MealHandle> chiefQueue;
 };
 
 class Restaurant
@@ -136,23 +428,96 @@ class Restaurant
   public:
     static Restaurant *getInstance();
 
-    void initialize();
+    void initialize(unsigned int customerCount = 10, unsigned int waiterCount = 3, unsigned int cookCount = 4);
     void close();
 
-    std::shared_ptr<Waiter> callForWaiter();
+    // Takes the waiter that has been free the longest, waiting until one is. Only fails
+    // (throws) once the restaurant closes.
+    coro::Task<std::shared_ptr<Waiter>> callForWaiter(const idle::Strategy &strategy = idle::parkAtOnce);
+    void releaseWaiter(std::shared_ptr<Waiter>);
+
+    // Wakes close() so it can check whether the restaurant has gone quiet.
+    void notifyProgress();
+
+    // Time from a customer's order to its meal on the table, and whether it beat its deadline.
+    void recordWait(coro::Clock::duration wait);
+    void recordDelivery(const Meal &meal);
+
+    // Of the last service, per priority.
+    size_t served(Priority priority) const
+    {
+        return _servedBy[priority].load(std::memory_order_relaxed);
+    }
+    size_t late(Priority priority) const
+    {
+        return _lateBy[priority].load(std::memory_order_relaxed);
+    }
+
+    // Ends stage for meal: records how long it took since the previous mark, for meals ordered
+    // once measuring started (after the warmup of open-loop arrivals). No-ops when metrics are
+    // compiled out.
+    void mark(MealHandle meal, Stage stage);
+    void addBusy(std::atomic<int64_t> Metrics::*role, coro::Clock::duration busy);
 
-    void addCustomer(std::shared_ptr<Customer>);
-    void removeCustomer(std::shared_ptr<Customer>);
+    // Of the last service, from initialize() until close() found the restaurant quiet. Virtual
+    // time in virtualTime mode.
+    coro::Clock::duration serviceTime() const
+    {
+        return _serviceTime;
+    }
+    coro::Clock::duration meanWait() const;
+
+    // Of the last service, summed by close() over every cook who worked it, and the chief.
+    WaitCost cookWaits() const
+    {
+        return _cookWaits;
+    }
+    WaitCost chiefWaits() const
+    {
+        return _chiefWaits;
+    }
+
+    // Seats a new customer in the slab; throws once it is full. The seat is freed for the next
+    // arrival once the customer has left and its task is over.
+    CustomerHandle addCustomer();
+    void removeCustomer(CustomerHandle);
     bool hasCustomers()
     {
-        return _customers.size() > 0;
+        std::lock_guard<std::mutex> lock(_stateMtx);
+        return _present > 0;
     }
 
+    Customer &customer(CustomerHandle handle)
+    {
+        return (*_customerSlab)[handle];
+    }
+
+    // A meal slot for customer, back in the arena with releaseMeal(). Throws once it is full.
+    MealHandle acquireMeal(CustomerHandle customer);
+    void releaseMeal(MealHandle);
+
+    Meal &meal(MealHandle handle)
+    {
+        return (*_meals)[handle];
+    }
+
+    // Staff can be hired and dismissed while serving. A new hire starts right away with the
+    // restaurant's idle strategy and batching. Only a free waiter is dismissed, and neither
+    // the last waiter nor the last cook: those return nullptr. The dismissed finish what they
+    // hold and are joined by close().
     void addWaiter(std::shared_ptr<Waiter>);
-    void removeWaiter(std::shared_ptr<Waiter>);
+    std::shared_ptr<Waiter> removeWaiter();
 
     void addCook(std::shared_ptr<Cook>);
-    void removeCook(std::shared_ptr<Cook>);
+    std::shared_ptr<Cook> removeCook();
+
+    size_t waiterCount();
+    size_t cookCount();
+
+    // Waiter and cook time paid for since initialize(), up to when close() found the restaurant
+    // quiet: the cost side of a staffing plan.
+    coro::Clock::duration waiterTime();
+    coro::Clock::duration cookTime();
 
     void setChief(std::shared_ptr<Chief>);
     std::shared_ptr<Chief> getChief()
@@ -160,16 +525,43 @@ class Restaurant
         return _chief;
     }
 
-    void logThreadSafe(const std::string &) const;
+    std::unique_ptr<Kitchen> kitchen{};
 
-    std::queue<Meal> kitchenQueue{};
+    std::atomic<bool> closeRestaurant{false};
 
-    std::condition_variable kitchenCv;
-    std::mutex kitchenMtx;
+    // Handed to the actors initialize() creates.
+    idle::Strategy cookIdle{};
+    idle::Strategy waiterIdle{};
+    idle::Strategy chiefIdle{};
+    Batching cookBatch{};
+    Batching chiefBatch{};
+    Routing routing{Routing::AffinityFirst};
+    Staffing staffing{};
+    Scheduling scheduling{};
 
-    std::condition_variable waiterCv;
+    // How often queue depths and busy waiters are sampled, and how often the stage summary is
+    // logged while serving (zero: only at close()).
+    std::chrono::milliseconds sampleInterval{50};
+    std::chrono::milliseconds metricsDump{0};
 
-    volatile bool closeRestaurant{false};
+    Metrics metrics{};
+
+    // Customers arriving on top of the ones initialize() seats, open loop. Seats bounds how many
+    // are in at once, arrivals finding none are turned away. Nothing during the warmup is
+    // measured: stage times only count meals ordered after it, busy time is clipped to the
+    // window after it, and queue sampling starts when it ends.
+    load::Profile arrivals{};
+    size_t seats{10000};
+
+    // Offered against achieved throughput over the last service's measured window.
+    const load::Report &loadReport() const
+    {
+        return _loadReport;
+    }
+
+    // Sleeps only advance a virtual clock and close() drives the whole service on the calling
+    // thread, jumping from one event to the next. Read by initialize().
+    bool virtualTime{false};
 
   private:
     Restaurant();
@@ -177,49 +569,120 @@ class Restaurant
 
     static Restaurant *instance;
 
-    std::vector<std::shared_ptr<Customer>> _customers{};
+    coro::Task<void> sample();
+    void logMetrics();
+
+    coro::Task<void> autoscale();
+
+    coro::Task<void> arrive();
+    void startMeasuring();
+    void reapCustomers();
+
+    // Adds the staff on duty since the last change to the time paid, up to until. Under
+    // _stateMtx.
+    void payStaff(coro::Clock::time_point until);
+
+    // Customers seated and not reaped yet, how many of them are still in, and those who left
+    // since the last reapCustomers().
+    std::unique_ptr<pool::Pool<Customer>> _customerSlab{};
+    size_t _present{0};
+    std::vector<CustomerHandle> _leaving{};
+
+    std::unique_ptr<pool::Pool<Meal>> _meals{};
+
+    // On duty, under _stateMtx while serving. The dismissed wait for close() to join them.
     std::vector<std::shared_ptr<Waiter>> _waiters{};
     std::vector<std::shared_ptr<Cook>> _cooks{};
+    std::vector<std::shared_ptr<Actor>> _dismissed{};
     std::shared_ptr<Chief> _chief{nullptr};
+
+    // Free waiters, sized to hold as many as may be hired so releasing one never blocks.
+    std::unique_ptr<coro::Channel<std::shared_ptr<Waiter>>> _freeWaiters{};
+
+    coro::Clock::time_point _paidUntil{};
+    coro::Clock::duration _waiterTime{};
+    coro::Clock::duration _cookTime{};
+
+    std::mutex _stateMtx;
+    std::condition_variable _stateCv;
+
+    std::unique_ptr<coro::Simulation> _simulation{};
+    coro::Clock::time_point _openedAt{};
+    coro::Clock::time_point _measuredFrom{};
+    coro::Clock::duration _serviceTime{};
+    size_t _mealsServed{0};
+    std::atomic<int64_t> _waitNs{0};
+    WaitCost _cookWaits{};
+    WaitCost _chiefWaits{};
+    std::atomic<size_t> _servedBy[priorityCount]{};
+    std::atomic<size_t> _lateBy[priorityCount]{};
+
+    std::future<void> _sampler{};
+    std::future<void> _autoscaler{};
+
+    // Callers waiting in callForWaiter(), for the autoscaler.
+    std::atomic<size_t> _calling{0};
+
+    // Set while arrivals may still come, under _stateMtx.
+    bool _arriving{false};
+    size_t _servedBefore{0};
+    load::Report _loadReport{};
+    std::future<void> _arrivalTask{};
 };
 
-inline void log(const Restaurant *restaurant, const std::ostringstream &oss)
-{
-    std::string final = "\033[31m Restaurant : \033[0m" + oss.str();
+inline constexpr async_log::Category restaurantLog{0, "Restaurant", "\033[31m", false};
+inline constexpr async_log::Category customerLog{1, "Customer", "\033[32m", true};
+inline constexpr async_log::Category cookLog{2, "Cook", "\033[33m", true};
+inline constexpr async_log::Category chiefLog{3, "Chief", "\033[34m", false};
+inline constexpr async_log::Category waiterLog{4, "Waiter", "\033[35m", true};
 
-    restaurant->logThreadSafe(final);
+inline const async_log::Category &logCategory(const Restaurant *)
+{
+    return restaurantLog;
 }
-
-inline void log(const Customer *customer, const std::ostringstream &oss)
+inline const async_log::Category &logCategory(const Customer *)
 {
-    Restaurant *restaurant = Restaurant::getInstance();
-    std::string final = "\033[32m Customer " + std::to_string(customer->ID) + " : \033[0m" + oss.str();
-
-    restaurant->logThreadSafe(final);
+    return customerLog;
 }
-
-inline void log(const Cook *cook, const std::ostringstream &oss)
+inline const async_log::Category &logCategory(const Cook *)
 {
-    std::string final = "\033[33m Cook " + std::to_string(cook->ID) + " : \033[0m" + oss.str();
-    Restaurant *restaurant = Restaurant::getInstance();
-
-    restaurant->logThreadSafe(final);
+    return cookLog;
 }
-
-inline void log(const Chief *chief, const std::ostringstream &oss)
+inline const async_log::Category &logCategory(const Chief *)
+{
+    return chiefLog;
+}
+inline const async_log::Category &logCategory(const Waiter *)
 {
-    std::string final = "\033[34m Chief : \033[0m" + oss.str();
-    Restaurant *restaurant = Restaurant::getInstance();
+    return waiterLog;
+}
 
-    restaurant->logThreadSafe(final);
+inline unsigned int logId(const Restaurant *)
+{
+    return 0;
 }
+inline unsigned int logId(const Chief *)
+{
+    return 0;
+}
+template <typename Source> unsigned int logId(const Source *source)
+{
+    return source->ID;
+}
+
+// Meals go into the record as three ingredient bytes.
+async_log::Arg logArg(const Meal &meal);
 
-inline void log(const Waiter *waiter, const std::ostringstream &oss)
+// format uses "{}" placeholders and must be a literal: it is only read when the line is written.
+template <typename Source, typename... Args>
+void log(async_log::Severity severity, const Source *source, const char *format, const Args &...args)
 {
-    std::string final = "\033[35m Waiter " + std::to_string(waiter->ID) + " : \033[0m" + oss.str();
-    Restaurant *restaurant = Restaurant::getInstance();
+    async_log::Logger::getInstance().log(severity, logCategory(source), logId(source), format, args...);
+}
 
-    restaurant->logThreadSafe(final);
+template <typename Source, typename... Args> void log(const Source *source, const char *format, const Args &...args)
+{
+    log(async_log::Severity::Info, source, format, args...);
 }
 } // namespace restaurant
 
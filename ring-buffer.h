@@ -0,0 +1,388 @@
+#ifndef RING_BUFFER
+#define RING_BUFFER
+
+#include "idle.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace ring_buffer
+{
+
+constexpr size_t cacheLine = 64;
+
+// Bounded multi-producer / multi-consumer queue (Vyukov). Every cell carries a sequence
+// number telling producers and consumers whose turn it is, so the fast path is one CAS on
+// the head or tail and no lock. Blocking calls only take a lock to park once the fast path
+// fails: push() parks while the buffer is full, pop() while it is empty.
+template <typename T> class RingBuffer
+{
+  public:
+    explicit RingBuffer(size_t capacity);
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // The rvalue overload leaves value untouched when the buffer is full or closed.
+    bool tryPush(const T &value);
+    bool tryPush(T &&value);
+    bool tryPop(T &value);
+
+    // Block while full / empty. Both return false once the buffer is closed, pop only after
+    // whatever was pushed before close() has been drained.
+    bool push(T value);
+    bool pop(T &value);
+
+    // pop() that spins and yields as configured before it parks.
+    bool pop(T &value, const idle::Strategy &strategy, idle::Counters *counters = nullptr);
+
+    // pop() that gives up after timeout; false on timeout as well as once closed and drained.
+    template <typename Rep, typename Period> bool popFor(T &value, std::chrono::duration<Rep, Period> timeout);
+
+    // Wakes every blocked caller; pushes fail from now on.
+    void close();
+
+    bool isClosed() const
+    {
+        return _closed.load(std::memory_order_acquire);
+    }
+
+    // Approximate while producers or consumers are running. The loads are seq_cst so callers
+    // can pair them with their own registration, like the blocking calls do.
+    size_t size() const
+    {
+        size_t head = _head.load();
+        size_t tail = _tail.load();
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // At least two cells: with one, a full cell and the next free slot share a sequence number.
+    static size_t roundUp(size_t capacity)
+    {
+        size_t rounded = 2;
+        while (rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    // Lock-free fast paths without any wakeup. pushCell only moves from value once it
+    // succeeds, so a blocking push can retry with it.
+    bool pushCell(T &value);
+    bool popCell(T &value);
+
+    // Threads parked on one side of the buffer. signaled counts notifications already on
+    // their way, so a burst of pushes wakes a sleeping consumer once instead of once per item.
+    struct Sleepers
+    {
+        std::atomic<size_t> count{0};
+        size_t signaled{0};
+        std::condition_variable cv;
+    };
+
+    void wake(Sleepers &sleepers);
+    void enter(Sleepers &sleepers);
+    void recheck(Sleepers &sleepers);
+    void leave(Sleepers &sleepers);
+
+    // Full / empty as seen from the counters. A cell can fail its push or pop while neither
+    // holds: someone claimed it but has not published it yet, so there is nothing to sleep on.
+    bool isFull() const
+    {
+        size_t head = _head.load();
+        return _tail.load() - head >= capacity();
+    }
+    bool isEmpty() const
+    {
+        size_t head = _head.load();
+        return _tail.load() == head;
+    }
+
+    bool popWait(T &value, bool timed, std::chrono::steady_clock::time_point deadline);
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+
+    alignas(cacheLine) std::atomic<size_t> _tail{0};
+    alignas(cacheLine) std::atomic<size_t> _head{0};
+
+    alignas(cacheLine) std::atomic<bool> _closed{false};
+    std::mutex _mtx;
+    Sleepers _producers;
+    Sleepers _consumers;
+};
+
+template <typename T> RingBuffer<T>::RingBuffer(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        throw("ring buffer capacity cannot be 0");
+    }
+
+    size_t rounded = roundUp(capacity);
+    _cells.reset(new Cell[rounded]);
+    _mask = rounded - 1;
+
+    for (size_t i = 0; i < rounded; i++)
+    {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T> bool RingBuffer<T>::tryPush(const T &value)
+{
+    T copy = value;
+    return tryPush(std::move(copy));
+}
+
+template <typename T> bool RingBuffer<T>::tryPush(T &&value)
+{
+    if (!pushCell(value))
+        return false;
+
+    wake(_consumers);
+    return true;
+}
+
+template <typename T> bool RingBuffer<T>::tryPop(T &value)
+{
+    if (!popCell(value))
+        return false;
+
+    wake(_producers);
+    return true;
+}
+
+template <typename T> bool RingBuffer<T>::pushCell(T &value)
+{
+    if (isClosed())
+        return false;
+
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell &cell = _cells[pos & _mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (_tail.compare_exchange_weak(pos, pos + 1))
+            {
+                cell.value = std::move(value);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // full
+        }
+        else
+        {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T> bool RingBuffer<T>::popCell(T &value)
+{
+    size_t pos = _head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell &cell = _cells[pos & _mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+        if (diff == 0)
+        {
+            if (_head.compare_exchange_weak(pos, pos + 1))
+            {
+                value = std::move(cell.value);
+                cell.value = T{};
+                cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // empty
+        }
+        else
+        {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Claiming a cell is a seq_cst CAS on _tail or _head. Sleepers count themselves in before
+// reading those counters, and wakers read the count after their CAS, so one of the two always
+// sees the other and no wakeup is lost. The common case costs a plain load.
+template <typename T> void RingBuffer<T>::wake(Sleepers &sleepers)
+{
+    if (sleepers.count.load() == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (sleepers.count.load() <= sleepers.signaled)
+            return;
+        sleepers.signaled++;
+    }
+    sleepers.cv.notify_one();
+}
+
+// enter, recheck and leave run under _mtx. Every check of the buffer uses up one pending
+// signal, so a signal that found nobody in wait() cannot make wake() skip a real sleeper.
+template <typename T> void RingBuffer<T>::enter(Sleepers &sleepers)
+{
+    sleepers.count.fetch_add(1);
+}
+
+template <typename T> void RingBuffer<T>::recheck(Sleepers &sleepers)
+{
+    if (sleepers.signaled > 0)
+        sleepers.signaled--;
+}
+
+template <typename T> void RingBuffer<T>::leave(Sleepers &sleepers)
+{
+    size_t count = sleepers.count.fetch_sub(1) - 1;
+    sleepers.signaled = std::min(sleepers.signaled, count);
+}
+
+template <typename T> bool RingBuffer<T>::push(T value)
+{
+    if (pushCell(value))
+    {
+        wake(_consumers);
+        return true;
+    }
+
+    bool pushed = false;
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        enter(_producers);
+        while (!isClosed())
+        {
+            recheck(_producers);
+            if ((pushed = pushCell(value)))
+                break;
+
+            if (isFull())
+            {
+                _producers.cv.wait(lock);
+            }
+            else
+            {
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+        }
+        leave(_producers);
+    }
+
+    if (pushed)
+        wake(_consumers);
+    return pushed;
+}
+
+template <typename T> bool RingBuffer<T>::pop(T &value)
+{
+    return tryPop(value) || popWait(value, false, {});
+}
+
+template <typename T>
+bool RingBuffer<T>::pop(T &value, const idle::Strategy &strategy, idle::Counters *counters)
+{
+    return strategy.wait([&] { return tryPop(value); }, [&] { return popWait(value, false, {}); }, counters);
+}
+
+template <typename T>
+template <typename Rep, typename Period>
+bool RingBuffer<T>::popFor(T &value, std::chrono::duration<Rep, Period> timeout)
+{
+    return tryPop(value) || popWait(value, true, std::chrono::steady_clock::now() + timeout);
+}
+
+template <typename T>
+bool RingBuffer<T>::popWait(T &value, bool timed, std::chrono::steady_clock::time_point deadline)
+{
+    bool popped = false;
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        enter(_consumers);
+        for (;;)
+        {
+            recheck(_consumers);
+            if ((popped = popCell(value)))
+                break;
+
+            if (!isEmpty())
+            {
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            else if (isClosed())
+            {
+                break;
+            }
+            else if (!timed)
+            {
+                _consumers.cv.wait(lock);
+            }
+            else if (_consumers.cv.wait_until(lock, deadline) == std::cv_status::timeout)
+            {
+                popped = popCell(value);
+                break;
+            }
+        }
+        leave(_consumers);
+    }
+
+    if (popped)
+        wake(_producers);
+    return popped;
+}
+
+template <typename T> void RingBuffer<T>::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _closed.store(true, std::memory_order_release);
+    }
+    _producers.cv.notify_all();
+    _consumers.cv.notify_all();
+}
+
+} // namespace ring_buffer
+
+#endif
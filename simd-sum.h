@@ -0,0 +1,330 @@
+#ifndef SIMD_SUM
+#define SIMD_SUM
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SUM_X86
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+
+enum class Isa
+{
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512,
+};
+
+inline const char *isaToString(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Sse2:
+        return "sse2";
+    case Isa::Avx2:
+        return "avx2";
+    case Isa::Avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+// Four independent accumulators so consecutive adds do not wait on each other.
+inline float sumScalar(const float *data, size_t n)
+{
+    float r0 = 0.0f, r1 = 0.0f, r2 = 0.0f, r3 = 0.0f;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        r0 += data[i];
+        r1 += data[i + 1];
+        r2 += data[i + 2];
+        r3 += data[i + 3];
+    }
+    for (; i < n; i++)
+    {
+        r0 += data[i];
+    }
+
+    return (r0 + r1) + (r2 + r3);
+}
+
+// Lanes of the double-precision accumulation below: every kernel adds data[i] into
+// lanes[i % wideLanes] in the same order, so the lanes come out bit-identical whichever ran.
+constexpr size_t wideLanes = 32;
+
+// Accumulates whole groups of wideLanes elements and returns how many it took.
+inline size_t accumulateScalar(const float *data, size_t n, double *lanes)
+{
+    size_t i = 0;
+    for (; i + wideLanes <= n; i += wideLanes)
+    {
+        for (size_t l = 0; l < wideLanes; l++)
+        {
+            lanes[l] += data[i + l];
+        }
+    }
+    return i;
+}
+
+#ifdef SIMD_SUM_X86
+
+// Number of leading elements to add one by one before data reaches an alignment boundary.
+inline size_t headLength(const float *data, size_t n, size_t alignment)
+{
+    size_t misalignment = reinterpret_cast<uintptr_t>(data) % alignment;
+    size_t head = misalignment == 0 ? 0 : (alignment - misalignment) / sizeof(float);
+
+    // a float pointer that is not even 4-byte aligned can never reach the boundary
+    return (misalignment % sizeof(float) != 0 || head > n) ? n : head;
+}
+
+__attribute__((target("sse2"))) inline float sumSse2(const float *data, size_t n)
+{
+    size_t head = headLength(data, n, 16);
+    float r = sumScalar(data, head);
+    data += head;
+    n -= head;
+
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_load_ps(data + i));
+        acc1 = _mm_add_ps(acc1, _mm_load_ps(data + i + 4));
+        acc2 = _mm_add_ps(acc2, _mm_load_ps(data + i + 8));
+        acc3 = _mm_add_ps(acc3, _mm_load_ps(data + i + 12));
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_load_ps(data + i));
+    }
+
+    __m128 acc = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+
+    return r + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sumScalar(data + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline float sumAvx2(const float *data, size_t n)
+{
+    size_t head = headLength(data, n, 32);
+    float r = sumScalar(data, head);
+    data += head;
+    n -= head;
+
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), acc2 = _mm256_setzero_ps(),
+           acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_load_ps(data + i));
+        acc1 = _mm256_add_ps(acc1, _mm256_load_ps(data + i + 8));
+        acc2 = _mm256_add_ps(acc2, _mm256_load_ps(data + i + 16));
+        acc3 = _mm256_add_ps(acc3, _mm256_load_ps(data + i + 24));
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_load_ps(data + i));
+    }
+
+    __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, half);
+
+    return r + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sumScalar(data + i, n - i);
+}
+
+__attribute__((target("avx512f"))) inline float sumAvx512(const float *data, size_t n)
+{
+    size_t head = headLength(data, n, 64);
+    float r = sumScalar(data, head);
+    data += head;
+    n -= head;
+
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps(), acc2 = _mm512_setzero_ps(),
+           acc3 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64)
+    {
+        acc0 = _mm512_add_ps(acc0, _mm512_load_ps(data + i));
+        acc1 = _mm512_add_ps(acc1, _mm512_load_ps(data + i + 16));
+        acc2 = _mm512_add_ps(acc2, _mm512_load_ps(data + i + 32));
+        acc3 = _mm512_add_ps(acc3, _mm512_load_ps(data + i + 48));
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_add_ps(acc0, _mm512_load_ps(data + i));
+    }
+
+    __m512 acc = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+
+    float h = 0.0f;
+    for (float lane : lanes)
+    {
+        h += lane;
+    }
+
+    return r + h + sumScalar(data + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline size_t accumulateSse2(const float *data, size_t n, double *lanes)
+{
+    __m128d acc[wideLanes / 2];
+    for (size_t l = 0; l < wideLanes / 2; l++)
+    {
+        acc[l] = _mm_loadu_pd(lanes + 2 * l);
+    }
+
+    size_t i = 0;
+    for (; i + wideLanes <= n; i += wideLanes)
+    {
+        for (size_t l = 0; l < wideLanes / 2; l += 2)
+        {
+            __m128 x = _mm_loadu_ps(data + i + 2 * l);
+            acc[l] = _mm_add_pd(acc[l], _mm_cvtps_pd(x));
+            acc[l + 1] = _mm_add_pd(acc[l + 1], _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+        }
+    }
+
+    for (size_t l = 0; l < wideLanes / 2; l++)
+    {
+        _mm_storeu_pd(lanes + 2 * l, acc[l]);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline size_t accumulateAvx2(const float *data, size_t n, double *lanes)
+{
+    __m256d acc[wideLanes / 4];
+    for (size_t l = 0; l < wideLanes / 4; l++)
+    {
+        acc[l] = _mm256_loadu_pd(lanes + 4 * l);
+    }
+
+    size_t i = 0;
+    for (; i + wideLanes <= n; i += wideLanes)
+    {
+        for (size_t l = 0; l < wideLanes / 4; l++)
+        {
+            acc[l] = _mm256_add_pd(acc[l], _mm256_cvtps_pd(_mm_loadu_ps(data + i + 4 * l)));
+        }
+    }
+
+    for (size_t l = 0; l < wideLanes / 4; l++)
+    {
+        _mm256_storeu_pd(lanes + 4 * l, acc[l]);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) inline size_t accumulateAvx512(const float *data, size_t n, double *lanes)
+{
+    __m512d acc[wideLanes / 8];
+    for (size_t l = 0; l < wideLanes / 8; l++)
+    {
+        acc[l] = _mm512_loadu_pd(lanes + 8 * l);
+    }
+
+    size_t i = 0;
+    for (; i + wideLanes <= n; i += wideLanes)
+    {
+        for (size_t l = 0; l < wideLanes / 8; l++)
+        {
+            acc[l] = _mm512_add_pd(acc[l], _mm512_cvtps_pd(_mm256_loadu_ps(data + i + 8 * l)));
+        }
+    }
+
+    for (size_t l = 0; l < wideLanes / 8; l++)
+    {
+        _mm512_storeu_pd(lanes + 8 * l, acc[l]);
+    }
+    return i;
+}
+
+#endif
+
+// Best instruction set the running CPU supports, probed once through CPUID.
+inline Isa detectIsa()
+{
+#ifdef SIMD_SUM_X86
+    static const Isa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return Isa::Avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::Avx2;
+        if (__builtin_cpu_supports("sse2"))
+            return Isa::Sse2;
+        return Isa::Scalar;
+    }();
+    return isa;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+// Runs the kernel for the requested instruction set, falling back to the best supported one.
+inline float sum(const float *data, size_t n, Isa isa)
+{
+    if (isa > detectIsa())
+    {
+        isa = detectIsa();
+    }
+
+    switch (isa)
+    {
+#ifdef SIMD_SUM_X86
+    case Isa::Avx512:
+        return sumAvx512(data, n);
+    case Isa::Avx2:
+        return sumAvx2(data, n);
+    case Isa::Sse2:
+        return sumSse2(data, n);
+#endif
+    default:
+        return sumScalar(data, n);
+    }
+}
+
+inline float sum(const float *data, size_t n)
+{
+    return sum(data, n, detectIsa());
+}
+
+// Adds data into wideLanes double lanes with the best supported kernel. Only whole groups of
+// wideLanes are taken; returns how many elements that was.
+inline size_t accumulate(const float *data, size_t n, double *lanes)
+{
+    switch (detectIsa())
+    {
+#ifdef SIMD_SUM_X86
+    case Isa::Avx512:
+        return accumulateAvx512(data, n, lanes);
+    case Isa::Avx2:
+        return accumulateAvx2(data, n, lanes);
+    case Isa::Sse2:
+        return accumulateSse2(data, n, lanes);
+#endif
+    default:
+        return accumulateScalar(data, n, lanes);
+    }
+}
+
+} // namespace simd
+
+#endif
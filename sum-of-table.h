@@ -1,15 +1,21 @@
 #ifndef SUM_OF_TABLE
 #define SUM_OF_TABLE
 
+#include "accumulator.h"
+#include "reduce.h"
+#include "simd-sum.h"
+#include "thread-pool.h"
+
 #include <cmath>
+#include <limits>
 #include <mutex>
-#include <thread>
 #include <vector>
 
 namespace sum_of_table
 {
 
-inline void sum(const std::vector<float> &table, float &r, size_t start = 0, size_t end = 1000)
+inline void sum(const std::vector<float> &table, float &r, size_t start = 0,
+                size_t end = std::numeric_limits<size_t>::max())
 {
     r = 0.0f;
     auto it_start = table.begin() + start;
@@ -23,7 +29,8 @@ inline void sum(const std::vector<float> &table, float &r, size_t start = 0, siz
     }
 }
 
-inline void sumMutex(const std::vector<float> &table, float &r, std::mutex &m, size_t start = 0, size_t end = 1000)
+inline void sumMutex(const std::vector<float> &table, float &r, std::mutex &m, size_t start = 0,
+                     size_t end = std::numeric_limits<size_t>::max())
 {
     auto it_start = table.begin() + start;
     auto it_end = table.begin() + std::min(end, table.size());
@@ -39,48 +46,79 @@ inline void sumMutex(const std::vector<float> &table, float &r, std::mutex &m, s
     }
 }
 
-inline float sequencial(const std::vector<float> &table)
+inline void sumSimd(const std::vector<float> &table, float &r, size_t start, size_t end)
 {
-    float r{0};
-    sum(table, r);
-    return r;
+    end = std::min(end, table.size());
+    r = start < end ? simd::sum(table.data() + start, end - start) : 0.0f;
 }
 
-inline float parallel(const std::vector<float> &table, size_t threadCount)
+// Neumaier-compensated running sum: compensation carries the low-order bits lost by each add.
+struct CompensatedSum
 {
-    if (threadCount == 0)
+    double sum{0.0};
+    double compensation{0.0};
+
+    void add(double x)
     {
-        throw("threadCount cannot not be 0");
+        double t = sum + x;
+        compensation += std::fabs(sum) >= std::fabs(x) ? (sum - t) + x : (x - t) + sum;
+        sum = t;
     }
-    if (threadCount > table.size())
+
+    void add(const CompensatedSum &other)
     {
-        throw("threadCount should not be larger than the table size");
+        add(other.sum);
+        add(other.compensation);
     }
 
-    size_t split = std::floor(table.size() / threadCount);
+    double value() const
+    {
+        return sum + compensation;
+    }
+};
 
-    std::vector<std::thread> threads;
-    std::vector<float> sums(threadCount);
+// Chunk boundaries are fixed by the table alone, never by the thread count.
+constexpr size_t deterministicChunk = 4096;
 
-    for (int i = 0; i < threadCount; i++)
+// Sum of one chunk in double precision over independent lanes, with the widest SIMD kernel the
+// CPU has; all kernels fill the lanes alike. A chunk holds few enough floats that the double
+// accumulators lose nothing a float result could show; the compensation is needed where chunk
+// sums of very different magnitudes meet.
+inline CompensatedSum sumChunk(const float *data, size_t n)
+{
+    double acc[simd::wideLanes] = {};
+    size_t i = simd::accumulate(data, n, acc);
+
+    for (; i < n; i++)
     {
-        size_t start = i * split;
-        size_t end = (i == threadCount - 1) ? table.size() : (i + 1) * split;
-        threads.push_back(std::thread(sum, std::ref(table), std::ref(sums[i]), start, end));
+        acc[0] += data[i];
     }
 
-    for (auto &thread : threads)
+    CompensatedSum r;
+    for (double lane : acc)
     {
-        thread.join();
+        r.add(lane);
     }
 
-    float final_r = 0;
-    sum(sums, final_r);
+    return r;
+}
 
-    return final_r;
+// Pairwise combination of chunks [begin, end) in a tree shaped only by the chunk count.
+inline CompensatedSum combineChunks(const std::vector<CompensatedSum> &chunks, size_t begin, size_t end)
+{
+    if (end - begin == 1)
+    {
+        return chunks[begin];
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    CompensatedSum r = combineChunks(chunks, begin, mid);
+    r.add(combineChunks(chunks, mid, end));
+
+    return r;
 }
 
-inline float parallelMutex(const std::vector<float> &table, size_t threadCount)
+inline void checkThreadCount(const std::vector<float> &table, size_t threadCount)
 {
     if (threadCount == 0)
     {
@@ -90,26 +128,133 @@ inline float parallelMutex(const std::vector<float> &table, size_t threadCount)
     {
         throw("threadCount should not be larger than the table size");
     }
+}
+
+// The plain scalar loop, in order: the baseline the other sums are measured against.
+inline float sequencial(const std::vector<float> &table)
+{
+    float r{0};
+    sum(table, r);
+    return r;
+}
+
+inline float parallel(const std::vector<float> &table, size_t threadCount)
+{
+    checkThreadCount(table, threadCount);
+
+    return transformReduceSlices(table.begin(), table.end(), 0.0f, Plus<float>{}, Identity{}, threadCount);
+}
+
+inline float simd(const std::vector<float> &table)
+{
+    float r{0};
+    sumSimd(table, r, 0, table.size());
+    return r;
+}
+
+inline float parallelSimd(const std::vector<float> &table, size_t threadCount)
+{
+    checkThreadCount(table, threadCount);
+
+    std::vector<float> sums(threadCount);
+    forEachSlice(table.size(), threadCount,
+                 [&](size_t i, size_t start, size_t end) { sumSimd(table, sums[i], start, end); });
 
-    size_t split = std::floor(table.size() / threadCount);
+    float final_r = 0;
+    sumSimd(sums, final_r, 0, sums.size());
+
+    return final_r;
+}
+
+inline float parallelMutex(const std::vector<float> &table, size_t threadCount)
+{
+    checkThreadCount(table, threadCount);
 
-    std::vector<std::thread> threads;
     std::mutex m;
     float result = 0;
+    forEachSlice(table.size(), threadCount,
+                 [&](size_t, size_t start, size_t end) { sumMutex(table, result, m, start, end); });
+
+    return result;
+}
 
-    for (int i = 0; i < threadCount; i++)
+// Every element goes through a shared accumulator, like parallelMutex, with the
+// accumulation strategy picked by mode.
+inline float parallelShared(const std::vector<float> &table, size_t threadCount, SharedMode mode)
+{
+    checkThreadCount(table, threadCount);
+
+    auto run = [&](auto &accumulator) {
+        forEachSlice(table.size(), threadCount, [&](size_t, size_t start, size_t end) {
+            for (size_t i = start; i < end; i++)
+            {
+                accumulator.add(table[i]);
+            }
+        });
+        return accumulator.load();
+    };
+
+    switch (mode)
+    {
+    case SharedMode::Atomic: {
+        AtomicAccumulator<float> accumulator;
+        return run(accumulator);
+    }
+    case SharedMode::Sharded: {
+        ShardedAccumulator<float> accumulator(threadCount);
+        return run(accumulator);
+    }
+    case SharedMode::Batched: {
+        BatchedAccumulator<float> accumulator;
+        forEachSlice(table.size(), threadCount, [&](size_t, size_t start, size_t end) {
+            auto batch = accumulator.batch();
+            for (size_t i = start; i < end; i++)
+            {
+                batch.add(table[i]);
+            }
+        });
+        return accumulator.load();
+    }
+    default: {
+        MutexAccumulator<float> accumulator;
+        return run(accumulator);
+    }
+    }
+}
+
+// Bit-identical result for any threadCount: every chunk is summed the same way whichever
+// thread picks it up, and chunks are always combined in the same tree order.
+inline float parallelDeterministic(const std::vector<float> &table, size_t threadCount)
+{
+    if (threadCount == 0)
     {
-        size_t start = i * split;
-        size_t end = (i == threadCount - 1) ? table.size() : (i + 1) * split;
-        threads.push_back(std::thread(sumMutex, std::ref(table), std::ref(result), std::ref(m), start, end));
+        throw("threadCount cannot not be 0");
     }
 
-    for (auto &thread : threads)
+    size_t chunkCount = (table.size() + deterministicChunk - 1) / deterministicChunk;
+    if (chunkCount == 0)
     {
-        thread.join();
+        return 0.0f;
     }
 
-    return result;
+    std::vector<CompensatedSum> chunks(chunkCount);
+    size_t split = (chunkCount + threadCount - 1) / threadCount;
+
+    thread_pool::ThreadPool::getInstance().parallelFor(
+        0, chunkCount,
+        [&](size_t c) {
+            size_t start = c * deterministicChunk;
+            size_t n = std::min(deterministicChunk, table.size() - start);
+            chunks[c] = sumChunk(table.data() + start, n);
+        },
+        split);
+
+    return static_cast<float>(combineChunks(chunks, 0, chunkCount).value());
+}
+
+inline float deterministic(const std::vector<float> &table)
+{
+    return parallelDeterministic(table, 1);
 }
 
 } // namespace sum_of_table
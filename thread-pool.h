@@ -0,0 +1,283 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace thread_pool
+{
+
+// Process-wide work-stealing pool. Every worker owns a deque: it pushes and pops its own
+// tasks at the back and steals from the front of the others when it runs dry.
+class ThreadPool
+{
+  public:
+    static ThreadPool &getInstance();
+
+    template <typename F, typename... Args>
+    auto submit(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    // Fire and forget: no future, so nothing to allocate besides the task itself. Used to
+    // resume coroutines.
+    template <typename F> void post(F &&f)
+    {
+        push(Task(std::forward<F>(f)));
+    }
+
+    // Calls f(i) for every i in [begin, end), split into chunks of grain indices.
+    // The calling thread takes part, so nested calls from inside the pool are fine.
+    template <typename F> void parallelFor(size_t begin, size_t end, F &&f, size_t grain = 0);
+
+    // Waits for a future while running pending tasks, so a worker never idles on its own subtasks.
+    template <typename T> T wait(std::future<T> &future);
+
+    size_t size() const
+    {
+        return _workerCount;
+    }
+
+  private:
+    using Task = std::function<void()>;
+
+    struct Worker
+    {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    static constexpr size_t notAWorker = static_cast<size_t>(-1);
+
+    ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    static size_t &currentWorker();
+
+    void push(Task task);
+    bool runPendingTask();
+    void workerLoop(size_t index);
+
+    const size_t _workerCount;
+    std::unique_ptr<Worker[]> _workers;
+    std::vector<std::thread> _threads{};
+    std::atomic<size_t> _nextWorker{0};
+
+    std::mutex _sleepMtx;
+    std::condition_variable _sleepCv;
+    std::atomic<size_t> _pending{0};
+    bool _stop{false};
+};
+
+inline ThreadPool &ThreadPool::getInstance()
+{
+    static ThreadPool instance(std::max(1u, std::thread::hardware_concurrency()));
+    return instance;
+}
+
+inline ThreadPool::ThreadPool(size_t threadCount) : _workerCount{threadCount}, _workers{new Worker[threadCount]}
+{
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMtx);
+        _stop = true;
+    }
+    _sleepCv.notify_all();
+
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+inline size_t &ThreadPool::currentWorker()
+{
+    static thread_local size_t index{notAWorker};
+    return index;
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::submit(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>
+{
+    using R = std::invoke_result_t<F, Args...>;
+
+    auto task = std::make_shared<std::packaged_task<R()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<R> future = task->get_future();
+
+    push([task]() { (*task)(); });
+
+    return future;
+}
+
+template <typename F> void ThreadPool::parallelFor(size_t begin, size_t end, F &&f, size_t grain)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    size_t n = end - begin;
+    if (grain == 0)
+    {
+        grain = std::max<size_t>(1, n / (size() * 4));
+    }
+    size_t chunks = (n + grain - 1) / grain;
+
+    std::atomic<size_t> next{0};
+    auto run = [&]() {
+        for (size_t c = next++; c < chunks; c = next++)
+        {
+            size_t chunkBegin = begin + c * grain;
+            size_t chunkEnd = std::min(end, chunkBegin + grain);
+
+            for (size_t i = chunkBegin; i < chunkEnd; i++)
+            {
+                f(i);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t i = 1; i < std::min(chunks, size() + 1); i++)
+    {
+        futures.push_back(submit(run));
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        run();
+    }
+    catch (...)
+    {
+        next = chunks;
+        error = std::current_exception();
+    }
+
+    for (auto &future : futures)
+    {
+        try
+        {
+            wait(future);
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename T> T ThreadPool::wait(std::future<T> &future)
+{
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if (!runPendingTask())
+        {
+            future.wait_for(std::chrono::microseconds(50));
+        }
+    }
+
+    return future.get();
+}
+
+inline void ThreadPool::push(Task task)
+{
+    size_t self = currentWorker();
+    size_t count = _workerCount;
+    size_t target = self < count ? self : _nextWorker++ % count;
+
+    {
+        std::lock_guard<std::mutex> lock(_workers[target].mtx);
+        _workers[target].tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_sleepMtx);
+        _pending++;
+    }
+    _sleepCv.notify_one();
+}
+
+inline bool ThreadPool::runPendingTask()
+{
+    size_t self = currentWorker();
+    size_t count = _workerCount;
+    Task task;
+
+    if (self < count)
+    {
+        Worker &worker = _workers[self];
+        std::lock_guard<std::mutex> lock(worker.mtx);
+        if (!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+    }
+
+    size_t start = self < count ? self + 1 : _nextWorker.load(std::memory_order_relaxed);
+    for (size_t i = 0; !task && i < count; i++)
+    {
+        Worker &victim = _workers[(start + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task)
+    {
+        return false;
+    }
+
+    _pending--;
+    task();
+
+    return true;
+}
+
+inline void ThreadPool::workerLoop(size_t index)
+{
+    currentWorker() = index;
+
+    while (true)
+    {
+        if (runPendingTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(_sleepMtx);
+        _sleepCv.wait(lock, [&] { return _stop || _pending > 0; });
+
+        if (_stop && _pending == 0)
+            return;
+    }
+}
+
+} // namespace thread_pool
+
+#endif